@@ -0,0 +1,351 @@
+// Offline conversion of LDR / HDR / EXR sources into the save_image format,
+// <source dir>/a/b.png is baked into <output dir>/a/b.png.lcim, with the bake parameters in
+// <output dir>/a/b.png.lcim.params; outputs newer than their source and baked with the same
+// parameters are skipped.
+// usage: lc-tools-baker <source dir | manifest.txt> <output dir> [options]
+//   --backend <name>      device backend, cpu by default
+//   --mips <n>            mip count, 0 (default) for the full chain
+//   --prefilter <r>       GGX-prefilter the mips of .hdr / .exr sources down to roughness r
+//   --threads <n>         decode threads, 0 (default) for all cores
+//   --batch <n>           files decoded and processed per device submission, 32 by default
+//   --half                store HDR / EXR sources as HALF4
+//   --force               rebuild outputs that are up to date
+#include <tools/image_lib.h>
+#include <runtime/context.h>
+#include <runtime/device.h>
+#include <runtime/stream.h>
+#include <core/clock.h>
+#include <core/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+using namespace luisa;
+using namespace luisa::compute;
+
+namespace {
+// bump when the baked output of the same parameters changes
+constexpr uint32_t bake_version = 1u;
+constexpr char const *params_extension = ".params";
+struct Options {
+    std::filesystem::path source;
+    std::filesystem::path output;
+    luisa::string backend{"cpu"};
+    uint32_t mips{0};
+    bool prefilter{false};
+    float roughness{0.0f};
+    uint32_t threads{0};
+    uint32_t batch{32};
+    bool half{false};
+    bool force{false};
+};
+struct Job {
+    std::filesystem::path source;
+    std::filesystem::path output;
+    size_t source_bytes{0};
+    bool env_map{false};
+    luisa::string params;
+    // from the start of the batch, through the decode and upload, until the output is renamed into place
+    double start_ms{0};
+    double decoded_ms{0};
+    double done_ms{0};
+    size_t output_bytes{0};
+    bool failed{false};
+    luisa::string error;
+};
+bool parse_options(int argc, char *argv[], Options &options) noexcept {
+    if (argc < 3) {
+        return false;
+    }
+    options.source = argv[1];
+    options.output = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        luisa::string_view arg{argv[i]};
+        auto has_value = i + 1 < argc;
+        if (arg == "--backend" && has_value) {
+            options.backend = argv[++i];
+        } else if (arg == "--mips" && has_value) {
+            options.mips = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--prefilter" && has_value) {
+            options.prefilter = true;
+            options.roughness = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--threads" && has_value) {
+            options.threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--batch" && has_value) {
+            options.batch = std::max(static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1u);
+        } else if (arg == "--half") {
+            options.half = true;
+        } else if (arg == "--force") {
+            options.force = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+luisa::string lower_extension(std::filesystem::path const &path) noexcept {
+    auto ext = path.extension().string();
+    for (auto &&c : ext) {
+        c = static_cast<char>(std::tolower(c));
+    }
+    return luisa::string{ext.c_str()};
+}
+bool is_source(std::filesystem::path const &path) noexcept {
+    auto ext = lower_extension(path);
+    for (auto e : {".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif", ".hdr", ".exr"}) {
+        if (ext == e) {
+            return true;
+        }
+    }
+    return false;
+}
+// every source under a directory, or every line of a manifest (relative to the manifest's directory)
+luisa::vector<std::pair<std::filesystem::path, std::filesystem::path>> list_sources(std::filesystem::path const &source) noexcept {
+    luisa::vector<std::pair<std::filesystem::path, std::filesystem::path>> result;
+    if (std::filesystem::is_directory(source)) {
+        for (auto &&entry : std::filesystem::recursive_directory_iterator{source}) {
+            if (entry.is_regular_file() && is_source(entry.path())) {
+                result.emplace_back(entry.path(), std::filesystem::relative(entry.path(), source));
+            }
+        }
+    } else {
+        std::ifstream manifest{source};
+        if (!manifest) {
+            LUISA_ERROR("Can not open manifest {}.", source.string());
+        }
+        auto base = source.parent_path();
+        std::string line;
+        while (std::getline(manifest, line)) {
+            while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) {
+                line.pop_back();
+            }
+            if (line.empty() || line.front() == '#') {
+                continue;
+            }
+            std::filesystem::path relative{line};
+            result.emplace_back(relative.is_absolute() ? relative : base / relative, relative.is_absolute() ? relative.filename() : relative);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+// everything that changes the bytes of an output
+luisa::string bake_params(Options const &options, bool env_map) noexcept {
+    return luisa::format("lcim-bake {} mips {} prefilter {} roughness {} half {}\n",
+                         bake_version, options.mips, env_map ? 1 : 0, env_map ? options.roughness : 0.0f, options.half ? 1 : 0);
+}
+std::filesystem::path params_path(std::filesystem::path const &output) noexcept {
+    auto path = output;
+    path += params_extension;
+    return path;
+}
+bool same_params(std::filesystem::path const &output, luisa::string const &params) noexcept {
+    std::ifstream file{params_path(output), std::ios::binary};
+    if (!file) {
+        return false;
+    }
+    std::string stored{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    return luisa::string_view{stored.data(), stored.size()} == params;
+}
+// std::fseek takes a long, which is 32 bits on Windows
+bool seek_file(std::FILE *file, uint64_t offset) noexcept {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+uint32_t full_chain(uint32_t width, uint32_t height) noexcept {
+    uint32_t mips = 1;
+    while ((std::max(width, height) >> mips) != 0) {
+        mips++;
+    }
+    return mips;
+}
+}// namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s <source dir | manifest.txt> <output dir> [--backend name] [--mips n] [--prefilter roughness] "
+                             "[--threads n] [--batch n] [--half] [--force]\n",
+                     argv[0]);
+        return 1;
+    }
+    Clock total_clock;
+    // incremental: only sources newer than their output, or baked with other parameters
+    luisa::vector<Job> jobs;
+    size_t skipped = 0;
+    for (auto &&[source, relative] : list_sources(options.source)) {
+        // the whole source name stays in the output name, a.png and a.jpg do not collide
+        auto output = options.output / relative;
+        output += ".lcim";
+        std::error_code ec;
+        auto source_time = std::filesystem::last_write_time(source, ec);
+        if (ec) {
+            LUISA_WARNING("Skip missing source {}.", source.string());
+            continue;
+        }
+        auto ext = lower_extension(source);
+        auto env_map = options.prefilter && (ext == ".hdr" || ext == ".exr");
+        auto params = bake_params(options, env_map);
+        auto output_time = std::filesystem::last_write_time(output, ec);
+        if (!options.force && !ec && output_time >= source_time && same_params(output, params)) {
+            skipped++;
+            continue;
+        }
+        jobs.push_back(Job{
+            .source = source,
+            .output = output,
+            .source_bytes = static_cast<size_t>(std::filesystem::file_size(source)),
+            .env_map = env_map,
+            .params = std::move(params)});
+    }
+    LUISA_INFO("{} sources to bake, {} up to date.", jobs.size(), skipped);
+    if (jobs.empty()) {
+        return 0;
+    }
+    Context context{argv[0]};
+    auto device = context.create_device(options.backend);
+    auto stream = device.create_stream();
+    auto cmd_buffer = stream.command_buffer();
+    auto shader_dir = options.output / ".shaders";
+    std::filesystem::create_directories(shader_dir);
+    ImageLib lib{device, luisa::string{shader_dir.string().c_str()}};
+    lib.set_profiling(true);
+    auto warm_up_flags = options.prefilter ? static_cast<uint32_t>(ImageLib::WARM_UP_ALL) : static_cast<uint32_t>(ImageLib::WARM_UP_MIP | ImageLib::WARM_UP_READ);
+    lib.warm_up(warm_up_flags, options.threads);
+    StagingPool pool;
+    std::random_device random;
+    std::atomic_size_t failed{0};
+    for (size_t first = 0; first < jobs.size(); first += options.batch) {
+        auto last = std::min(first + options.batch, jobs.size());
+        // decode the whole batch on all cores; the full chain needs the decoded size, so those sources
+        // and the prefiltered ones are read with one mip and filtered into their chain below
+        luisa::vector<ImageLib::ReadRequest> requests;
+        for (auto i : vstd::range(first, last)) {
+            auto &&job = jobs[i];
+            requests.push_back(ImageLib::ReadRequest{
+                .file_name = luisa::string{job.source.string().c_str()},
+                .mip_level = job.env_map || options.mips == 0 ? 1u : options.mips,
+                .option = {.half = options.half}});
+        }
+        auto start_ms = total_clock.toc();
+        for (auto i : vstd::range(first, last)) {
+            jobs[i].start_ms = start_ms;
+        }
+        // a source that can not be decoded fails its own job, the rest of the batch is still baked
+        auto images = lib.read_batch(requests, cmd_buffer, options.threads, [&](size_t index, Image<float> const &, luisa::string_view error) {
+            auto &&job = jobs[first + index];
+            job.decoded_ms = total_clock.toc();
+            if (!error.empty()) {
+                job.failed = true;
+                job.error = error;
+                failed++;
+            }
+        });
+        for (auto i : vstd::range(first, last)) {
+            auto &&job = jobs[i];
+            if (job.failed) {
+                continue;
+            }
+            auto &&source = images[i - first];
+            auto size = source.size();
+            auto mips = options.mips == 0 ? full_chain(size.x, size.y) : std::min(options.mips, full_chain(size.x, size.y));
+            auto image = std::move(source);
+            if (image.mip_levels() != mips) {
+                auto chain = device.create_image<float>(image.storage(), size.x, size.y, mips);
+                cmd_buffer << chain.view(0).copy_from(image.view(0))
+                           << [image = std::move(image)] {};
+                if (job.env_map) {
+                    lib.generate_cubemap_mip(chain, cmd_buffer, options.roughness, {.mode = ImageLib::PrefilterMode::FILTERED});
+                } else {
+                    lib.generate_mip(chain, cmd_buffer);
+                }
+                image = std::move(chain);
+            }
+            std::filesystem::create_directories(job.output.parent_path());
+            auto temp_path = job.output;
+            temp_path += luisa::format(".{:08x}.tmp", random()).c_str();
+            auto file = std::fopen(temp_path.string().c_str(), "wb");
+            if (file == nullptr) {
+                job.failed = true;
+                job.error = luisa::format("Can not write {}.", temp_path.string());
+                failed++;
+                continue;
+            }
+            // the header at offset 0 is the last piece, the output is complete once it arrives
+            lib.save_image(image, cmd_buffer, pool, [&, file, temp_path, job = &job](size_t offset, luisa::span<std::byte const> data) mutable {
+                if (!job->failed &&
+                    (!seek_file(file, offset) || std::fwrite(data.data(), 1, data.size(), file) != data.size())) {
+                    job->failed = true;
+                    job->error = luisa::format("Writing {} failed.", temp_path.string());
+                }
+                job->output_bytes = std::max(job->output_bytes, offset + data.size());
+                if (offset != 0) {
+                    return;
+                }
+                if (std::fclose(file) != 0 && !job->failed) {
+                    job->failed = true;
+                    job->error = luisa::format("Closing {} failed.", temp_path.string());
+                }
+                std::error_code ec;
+                if (!job->failed) {
+                    std::filesystem::rename(temp_path, job->output, ec);
+                    if (ec) {
+                        job->failed = true;
+                        job->error = luisa::format("Can not rename {} to {}: {}.", temp_path.string(), job->output.string(), ec.message());
+                    }
+                }
+                if (job->failed) {
+                    failed++;
+                    std::filesystem::remove(temp_path, ec);
+                } else {
+                    // written after the output, a crash in between leaves stale parameters and a rebuild
+                    std::ofstream params{params_path(job->output), std::ios::binary | std::ios::trunc};
+                    params.write(job->params.data(), static_cast<std::streamsize>(job->params.size()));
+                    if (!params) {
+                        LUISA_WARNING("Can not write {}, {} will be rebuilt.", params_path(job->output).string(), job->output.string());
+                    }
+                }
+                job->done_ms = total_clock.toc();
+            });
+            cmd_buffer << [image = std::move(image)] {};
+        }
+        cmd_buffer << commit();
+    }
+    stream.synchronize();
+    auto total_ms = total_clock.toc();
+    size_t source_bytes = 0;
+    size_t output_bytes = 0;
+    for (auto &&job : jobs) {
+        if (job.failed) {
+            LUISA_WARNING("{} failed: {}", job.source.string(), job.error);
+            continue;
+        }
+        source_bytes += job.source_bytes;
+        output_bytes += job.output_bytes;
+        // the files of a batch share the device, so their times overlap
+        auto file_seconds = std::max(job.done_ms - job.start_ms, 1e-3) * 1e-3;
+        LUISA_INFO("{} -> {}: {:.2f} MB -> {:.2f} MB in {:.1f} ms ({:.1f} ms decode), {:.1f} MB/s in, {:.1f} MB/s out",
+                   job.source.string(), job.output.string(),
+                   job.source_bytes / (1024.0 * 1024.0), job.output_bytes / (1024.0 * 1024.0),
+                   file_seconds * 1e3, job.decoded_ms - job.start_ms,
+                   job.source_bytes / (1024.0 * 1024.0) / file_seconds, job.output_bytes / (1024.0 * 1024.0) / file_seconds);
+    }
+    for (auto &&phase : lib.profile_stats()) {
+        LUISA_INFO("  {}: {} calls, {:.1f} ms total, {:.1f} ms max, {:.2f} MB",
+                   phase.name, phase.count, phase.total_ms, phase.max_ms, phase.bytes / (1024.0 * 1024.0));
+    }
+    auto seconds = std::max(total_ms, 1e-3) * 1e-3;
+    auto baked = jobs.size() - failed.load();
+    LUISA_INFO("Baked {} files ({} failed, {} up to date) in {:.2f} s: {:.1f} files/s, {:.1f} MB/s in, {:.1f} MB/s out.",
+               baked, failed.load(), skipped, seconds, baked / seconds,
+               source_bytes / (1024.0 * 1024.0) / seconds, output_bytes / (1024.0 * 1024.0) / seconds);
+    return failed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+// Timings of the ImageLib operations on synthetic images, printed as JSON.
+// usage: lc-tools-bench [backend = cpu] [output.json] [work_dir]
+#include <tools/image_lib.h>
+#include <runtime/context.h>
+#include <runtime/device.h>
+#include <runtime/stream.h>
+#include <core/clock.h>
+#include <core/logging.h>
+#include <dsl/syntax.h>
+#include <stb/stb_image_write.h>
+#include <tinyexr.h>
+#include <cstdio>
+#include <cmath>
+#include <random>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace luisa;
+using namespace luisa::compute;
+
+namespace {
+size_t peak_rss_bytes() noexcept {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024u;
+#endif
+#endif
+}
+luisa::string_view storage_name(PixelStorage storage) noexcept {
+    switch (storage) {
+        case PixelStorage::BYTE1: return "BYTE1";
+        case PixelStorage::BYTE4: return "BYTE4";
+        case PixelStorage::HALF1: return "HALF1";
+        case PixelStorage::HALF4: return "HALF4";
+        case PixelStorage::FLOAT1: return "FLOAT1";
+        case PixelStorage::FLOAT4: return "FLOAT4";
+        default: return "OTHER";
+    }
+}
+struct PrefilterError {
+    uint32_t level;
+    float roughness;
+    double rmse;
+    double relative_rmse;
+};
+struct Record {
+    luisa::string op;
+    luisa::string storage;
+    uint3 size;
+    uint32_t mips;
+    double ms;
+    size_t bytes;
+    size_t texels;
+};
+class Bench {
+    Stream &_stream;
+    CommandBuffer _cmd;
+    uint32_t _iterations;
+    luisa::vector<Record> _records;
+    luisa::vector<PrefilterError> _prefilter_errors;
+
+public:
+    Bench(Stream &stream, uint32_t iterations) noexcept
+        : _stream(stream), _cmd(stream.command_buffer()), _iterations(iterations) {}
+    CommandBuffer &cmd() noexcept { return _cmd; }
+    void sync() noexcept {
+        _cmd << commit();
+        _stream.synchronize();
+    }
+    // one untimed run, then the mean of the timed ones, every run is synchronized
+    template<typename F>
+    double time(F &&f) noexcept {
+        f();
+        sync();
+        Clock clock;
+        for (uint32_t i = 0; i < _iterations; ++i) {
+            f();
+            sync();
+        }
+        return clock.toc() / _iterations;
+    }
+    void add(luisa::string op, PixelStorage storage, uint3 size, uint32_t mips, double ms, size_t bytes, size_t texels) noexcept {
+        LUISA_INFO("{} {} {}x{}x{} mips {}: {} ms", op, storage_name(storage), size.x, size.y, size.z, mips, ms);
+        _records.push_back(Record{std::move(op), luisa::string{storage_name(storage)}, size, mips, ms, bytes, texels});
+    }
+    void add_prefilter_error(uint32_t level, float roughness, double rmse, double relative_rmse) noexcept {
+        LUISA_INFO("prefilter level {} roughness {}: FILTERED vs REFERENCE RMSE {} (relative {})", level, roughness, rmse, relative_rmse);
+        _prefilter_errors.push_back(PrefilterError{level, roughness, rmse, relative_rmse});
+    }
+    luisa::string json(ImageLib::WarmUpStats const &warm_up, luisa::string_view backend, size_t staging_peak) const noexcept {
+        luisa::string result = luisa::format(
+            "{{\n  \"backend\": \"{}\",\n  \"iterations\": {},\n  \"warm_up\": {{\"shaders\": {}, \"total_ms\": {}, \"shader_ms\": {}}},\n"
+            "  \"peak_rss_bytes\": {},\n  \"staging_pool_peak_bytes\": {},\n  \"results\": [\n",
+            backend, _iterations, warm_up.shader_count, warm_up.total_ms, warm_up.shader_ms, peak_rss_bytes(), staging_peak);
+        for (auto i : vstd::range(_records.size())) {
+            auto &&r = _records[i];
+            auto seconds = std::max(r.ms, 1e-6) * 1e-3;
+            result += luisa::format(
+                "    {{\"op\": \"{}\", \"storage\": \"{}\", \"width\": {}, \"height\": {}, \"depth\": {}, \"mips\": {}, "
+                "\"ms\": {:.4f}, \"bytes\": {}, \"mb_per_s\": {:.2f}, \"texels_per_s\": {:.0f}}}{}\n",
+                r.op, r.storage, r.size.x, r.size.y, r.size.z, r.mips,
+                r.ms, r.bytes, static_cast<double>(r.bytes) / (1024.0 * 1024.0) / seconds, static_cast<double>(r.texels) / seconds,
+                i + 1 == _records.size() ? "" : ",");
+        }
+        result += "  ],\n  \"prefilter_error\": [\n";
+        for (auto i : vstd::range(_prefilter_errors.size())) {
+            auto &&e = _prefilter_errors[i];
+            result += luisa::format(
+                "    {{\"level\": {}, \"roughness\": {:.3f}, \"rmse\": {:.6f}, \"relative_rmse\": {:.6f}}}{}\n",
+                e.level, e.roughness, e.rmse, e.relative_rmse, i + 1 == _prefilter_errors.size() ? "" : ",");
+        }
+        result += "  ]\n}\n";
+        return result;
+    }
+};
+// smooth gradients plus noise, so neither the decoders nor the filters see constant data
+luisa::vector<float> synthetic_rgba(uint32_t width, uint32_t height, float scale) noexcept {
+    std::mt19937 rng{width * 31u + height};
+    std::uniform_real_distribution<float> noise{0.0f, 0.1f};
+    luisa::vector<float> pixels(static_cast<size_t>(width) * height * 4u);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            auto p = &pixels[(static_cast<size_t>(y) * width + x) * 4u];
+            auto u = static_cast<float>(x) / width;
+            auto v = static_cast<float>(y) / height;
+            p[0] = (0.5f + 0.4f * std::sin(u * 12.0f) + noise(rng)) * scale;
+            p[1] = (0.5f + 0.4f * std::cos(v * 9.0f) + noise(rng)) * scale;
+            p[2] = (u * v + noise(rng)) * scale;
+            p[3] = 1.0f;
+        }
+    }
+    return pixels;
+}
+struct SourceFiles {
+    luisa::string ldr, hdr, exr;
+};
+SourceFiles write_sources(std::filesystem::path const &dir, uint32_t size) noexcept {
+    auto width = size;
+    auto height = size;
+    auto hdr_pixels = synthetic_rgba(width, height, 4.0f);
+    auto ldr_pixels = synthetic_rgba(width, height, 1.0f);
+    luisa::vector<uint8_t> bytes(ldr_pixels.size());
+    for (auto i : vstd::range(bytes.size())) {
+        bytes[i] = static_cast<uint8_t>(std::clamp(ldr_pixels[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+    auto path = [&](char const *ext) {
+        return luisa::string{(dir / luisa::format("bench_{}{}", size, ext).c_str()).string().c_str()};
+    };
+    SourceFiles files{path(".png"), path(".hdr"), path(".exr")};
+    stbi_write_png(files.ldr.c_str(), width, height, 4, bytes.data(), width * 4);
+    stbi_write_hdr(files.hdr.c_str(), width, height, 4, hdr_pixels.data());
+    char const *err = nullptr;
+    if (SaveEXR(hdr_pixels.data(), width, height, 4, 1, files.exr.c_str(), &err) < 0) {
+        LUISA_ERROR("Write EXR error: {}", err);
+    }
+    return files;
+}
+ImageLib::ChunkWriteFunc file_writer(std::FILE *file) noexcept {
+    return [file](size_t offset, luisa::span<std::byte const> data) {
+        std::fseek(file, static_cast<long>(offset), SEEK_SET);
+        std::fwrite(data.data(), 1, data.size(), file);
+    };
+}
+size_t chain_texels(uint3 size, uint32_t mips) noexcept {
+    size_t texels = 0;
+    for (auto i : vstd::range(mips)) {
+        texels += static_cast<size_t>(std::max(size.x >> i, 1u)) * std::max(size.y >> i, 1u) * std::max(size.z >> i, 1u);
+    }
+    return texels;
+}
+uint32_t full_chain(uint32_t size) noexcept {
+    uint32_t mips = 1;
+    while ((size >> mips) != 0) {
+        mips++;
+    }
+    return mips;
+}
+}// namespace
+
+int main(int argc, char *argv[]) {
+    luisa::string backend = argc > 1 ? argv[1] : "cpu";
+    auto work_dir = argc > 3 ? std::filesystem::path{argv[3]} : std::filesystem::temp_directory_path() / "lc_tools_bench";
+    std::filesystem::create_directories(work_dir);
+    Context context{argv[0]};
+    auto device = context.create_device(backend);
+    auto stream = device.create_stream();
+    ImageLib lib{device, luisa::string{(work_dir / "shaders").string().c_str()}};
+    std::filesystem::create_directories(work_dir / "shaders");
+    auto warm_up = lib.warm_up();
+    // baseline of the fused generate_mip: a 2x2 box, one level per dispatch
+    Kernel2D mip_one_level_kernel = [](ImageVar<float> src, ImageVar<float> dst) noexcept {
+        auto coord = dispatch_id().xy();
+        auto src_coord = coord * make_uint2(2u);
+        auto sum = src.read(src_coord) + src.read(src_coord + make_uint2(1u, 0u)) +
+                   src.read(src_coord + make_uint2(0u, 1u)) + src.read(src_coord + make_uint2(1u, 1u));
+        dst.write(coord, sum * 0.25f);
+    };
+    auto mip_one_level = device.compile(mip_one_level_kernel);
+    Bench bench{stream, 3};
+    auto &cmd = bench.cmd();
+    StagingPool pool;
+    for (auto size : {256u, 1024u, 2048u}) {
+        auto files = write_sources(work_dir, size);
+        auto size3 = make_uint3(size, size, 1u);
+        auto texels = static_cast<size_t>(size) * size;
+        // decode and upload of a single mip
+        auto ms = bench.time([&] { auto img = lib.read_ldr(files.ldr, cmd, 1); cmd << [img = std::move(img)] {}; });
+        bench.add("read_ldr", PixelStorage::BYTE4, size3, 1, ms, texels * 4u, texels);
+        ms = bench.time([&] { auto img = lib.read_hdr(files.hdr, cmd, 1); cmd << [img = std::move(img)] {}; });
+        bench.add("read_hdr", PixelStorage::FLOAT4, size3, 1, ms, texels * 16u, texels);
+        ms = bench.time([&] { auto img = lib.read_exr(files.exr, cmd, 1); cmd << [img = std::move(img)] {}; });
+        bench.add("read_exr", PixelStorage::FLOAT4, size3, 1, ms, texels * 16u, texels);
+        ms = bench.time([&] { auto img = lib.read_exr(files.exr, cmd, 1, {.half = true}); cmd << [img = std::move(img)] {}; });
+        bench.add("read_exr", PixelStorage::HALF4, size3, 1, ms, texels * 8u, texels);
+        // save / load round trip of the full chain in every storage
+        auto mips = full_chain(size);
+        luisa::vector<Image<float>> sources;
+        sources.emplace_back(lib.read_ldr(files.ldr, cmd, mips));
+        sources.emplace_back(lib.read_hdr(files.hdr, cmd, mips, {.half = true}));
+        sources.emplace_back(lib.read_hdr(files.hdr, cmd, mips));
+        bench.sync();
+        for (auto &&img : sources) {
+            auto path = work_dir / luisa::format("bench_{}_{}.lcim", size, storage_name(img.storage())).c_str();
+            ms = bench.time([&] {
+                auto file = std::fopen(path.string().c_str(), "wb");
+                lib.save_image(img, cmd, pool, file_writer(file));
+                bench.sync();
+                std::fclose(file);
+            });
+            bench.add("save_image", img.storage(), size3, mips, ms, img.byte_size(), chain_texels(size3, mips));
+            ms = bench.time([&] { auto loaded = lib.load_image<float>(path, cmd); cmd << [loaded = std::move(loaded)] {}; });
+            bench.add("load_image", img.storage(), size3, mips, ms, img.byte_size(), chain_texels(size3, mips));
+            for (auto level_count : {2u, 4u, 8u, mips}) {
+                if (level_count > mips) {
+                    continue;
+                }
+                auto chain = device.create_image<float>(img.storage(), size, size, level_count);
+                cmd << chain.view(0).copy_from(img.view(0));
+                ms = bench.time([&] { lib.generate_mip(chain, cmd); });
+                bench.add("generate_mip", img.storage(), size3, level_count, ms, chain.byte_size(), chain_texels(size3, level_count));
+                ms = bench.time([&] {
+                    for (auto level : vstd::range(1u, level_count)) {
+                        cmd << mip_one_level(chain.view(level - 1), chain.view(level)).dispatch(chain.view(level).size());
+                    }
+                });
+                bench.add("generate_mip_baseline", img.storage(), size3, level_count, ms, chain.byte_size(), chain_texels(size3, level_count));
+            }
+        }
+        // a non-power-of-two chain
+        {
+            auto npot = size - 1;
+            auto pixels = synthetic_rgba(npot, npot, 4.0f);
+            auto chain = device.create_image<float>(PixelStorage::FLOAT4, npot, npot, full_chain(npot));
+            cmd << chain.view(0).copy_from(pixels.data());
+            bench.sync();
+            ms = bench.time([&] { lib.generate_mip(chain, cmd); });
+            bench.add("generate_mip_npot", PixelStorage::FLOAT4, make_uint3(npot, npot, 1u), chain.mip_levels(), ms, chain.byte_size(), chain_texels(make_uint3(npot, npot, 1u), chain.mip_levels()));
+        }
+    }
+    // reflection prefilter of a lat-long map, both modes, and the error of FILTERED against REFERENCE
+    {
+        auto pixels = synthetic_rgba(1024, 512, 4.0f);
+        auto lat_long = device.create_image<float>(PixelStorage::FLOAT4, 1024, 512);
+        auto env = device.create_image<float>(PixelStorage::FLOAT4, 1024, 512, 6);
+        cmd << lat_long.copy_from(pixels.data());
+        bench.sync();
+        luisa::vector<float4> levels[2][6];
+        for (auto mode : {ImageLib::PrefilterMode::REFERENCE, ImageLib::PrefilterMode::FILTERED}) {
+            auto generate = [&] {
+                cmd << env.view(0).copy_from(lat_long.view(0));
+                lib.generate_cubemap_mip(env, cmd, 0.0f, {.mode = mode});
+            };
+            auto ms = bench.time(generate);
+            bench.add(mode == ImageLib::PrefilterMode::REFERENCE ? "generate_cubemap_mip_reference" : "generate_cubemap_mip_filtered",
+                      PixelStorage::FLOAT4, make_uint3(1024u, 512u, 1u), 6, ms, env.byte_size(), chain_texels(make_uint3(1024u, 512u, 1u), 6));
+            generate();
+            auto &&chain = levels[mode == ImageLib::PrefilterMode::FILTERED ? 1 : 0];
+            for (auto level : vstd::range(1u, 6u)) {
+                auto level_size = env.view(level).size();
+                chain[level].resize(static_cast<size_t>(level_size.x) * level_size.y);
+                cmd << env.view(level).copy_to(chain[level].data());
+            }
+            bench.sync();
+        }
+        for (auto level : vstd::range(1u, 6u)) {
+            auto &&reference = levels[0][level];
+            auto &&filtered = levels[1][level];
+            double error = 0.0;
+            double energy = 0.0;
+            for (auto i : vstd::range(reference.size())) {
+                for (auto c : vstd::range(3)) {
+                    auto d = static_cast<double>(filtered[i][c]) - reference[i][c];
+                    error += d * d;
+                    energy += static_cast<double>(reference[i][c]) * reference[i][c];
+                }
+            }
+            auto rmse = std::sqrt(error / (reference.size() * 3.0));
+            auto relative = std::sqrt(error / std::max(energy, 1e-12));
+            // roughness schedule of generate_cubemap_mip with roughness 0
+            auto roughness = 1.0f - static_cast<float>(level) / 5.0f;
+            bench.add_prefilter_error(level, roughness, rmse, relative);
+        }
+    }
+    // volumes: 3D mips and save / load round trip
+    for (auto size : {64u, 128u, 97u}) {
+        auto size3 = make_uint3(size);
+        auto mips = full_chain(size);
+        auto volume = device.create_volume<float>(PixelStorage::FLOAT4, size, size, size, mips);
+        auto pixels = synthetic_rgba(size, size * size, 1.0f);
+        cmd << volume.view(0).copy_from(pixels.data());
+        auto ms = bench.time([&] { lib.generate_volume_mip(volume, cmd); });
+        bench.add("generate_volume_mip", PixelStorage::FLOAT4, size3, mips, ms, volume.byte_size(), chain_texels(size3, mips));
+        auto path = work_dir / luisa::format("bench_volume_{}.lcim", size).c_str();
+        ms = bench.time([&] {
+            auto file = std::fopen(path.string().c_str(), "wb");
+            lib.save_volume(volume, cmd, pool, file_writer(file));
+            bench.sync();
+            std::fclose(file);
+        });
+        bench.add("save_volume", PixelStorage::FLOAT4, size3, mips, ms, volume.byte_size(), chain_texels(size3, mips));
+        ms = bench.time([&] { auto loaded = lib.load_volume<float>(path, cmd); cmd << [loaded = std::move(loaded)] {}; });
+        bench.add("load_volume", PixelStorage::FLOAT4, size3, mips, ms, volume.byte_size(), chain_texels(size3, mips));
+    }
+    auto json = bench.json(warm_up, backend, pool.peak_bytes());
+    if (argc > 2) {
+        auto file = std::fopen(argv[2], "wb");
+        if (file == nullptr) {
+            LUISA_WARNING("Can not write {}, printing the results instead.", argv[2]);
+            std::fwrite(json.data(), 1, json.size(), stdout);
+            return 1;
+        }
+        auto written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+        if (std::fclose(file) != 0 || !written) {
+            LUISA_WARNING("Writing {} failed.", argv[2]);
+            return 1;
+        }
+    } else {
+        std::fwrite(json.data(), 1, json.size(), stdout);
+    }
+    return 0;
+}
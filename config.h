@@ -1,6 +1,10 @@
 #pragma once
+#ifdef _WIN32
 #ifdef LC_TOOL_EXPORT_DLL
 #define LC_TOOL_API __declspec(dllexport)
 #else
 #define LC_TOOL_API __declspec(dllimport)
-#endif
\ No newline at end of file
+#endif
+#else
+#define LC_TOOL_API __attribute__((visibility("default")))
+#endif
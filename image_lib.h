@@ -1,16 +1,26 @@
 #pragma once
 #include <tools/config.h>
+#include <tools/staging_pool.h>
 #include <runtime/image.h>
 #include <runtime/volume.h>
 #include <runtime/command_buffer.h>
 #include <runtime/shader.h>
+#include <runtime/buffer.h>
 #include <runtime/bindless_array.h>
 #include <vstl/common.h>
 #include <vstl/functional.h>
 #include <filesystem>
+#include <limits>
+#include <mutex>
 
 namespace luisa::compute {
 class IBinaryStream;
+class MappedFile;
+namespace imglib_detail {
+struct DecodedImage;
+struct DecodedExr;
+struct Profiler;
+}// namespace imglib_detail
 namespace detail {
 template<size_t i, template<typename...> typename Collection, typename T, typename... Ts>
 static constexpr decltype(auto) TypeAccumulator() {
@@ -21,31 +31,151 @@ static constexpr decltype(auto) TypeAccumulator() {
     }
 }
 }// namespace detail
+// Options taken as defaulted arguments live at namespace scope, GCC and Clang reject a nested class with
+// default member initializers in a default argument of the enclosing class; ImageLib aliases them.
+// mips [begin, end) of the stored chain, end is clamped to the stored mip count
+struct ImageMipRange {
+    uint32_t begin{0};
+    uint32_t end{std::numeric_limits<uint32_t>::max()};
+    // drop the "count" finest mips
+    [[nodiscard]] static constexpr ImageMipRange skip(uint32_t count) noexcept { return {count, std::numeric_limits<uint32_t>::max()}; }
+};
+enum struct ImagePrefilterMode : uint32_t {
+    // 65536 point samples per texel from the previous mip
+    REFERENCE,
+    // precomputed GGX samples per roughness level, each read from a box-filtered
+    // chain of mip 0 at the lod given by its pdf (filtered importance sampling)
+    FILTERED
+};
+struct ImagePrefilterOption {
+    ImagePrefilterMode mode{ImagePrefilterMode::REFERENCE};
+    // samples per texel in FILTERED mode
+    uint32_t sample_count{128};
+};
+// storage of the images produced by the readers
+struct ImageReadOption {
+    // keep the channel count of the file instead of expanding to four,
+    // three-channel files are still padded to four
+    bool native_channels{false};
+    // store HDR and EXR images as HALF* instead of FLOAT*, converted on the device
+    bool half{false};
+};
+// part of an EXR file to load, in texels of the full-resolution display window;
+// texels outside the data window read as 0
+struct ImageExrRegion {
+    uint2 offset{0u};
+    // 0 extends to the edge of the image
+    uint2 size{0u};
+    // every output texel averages a 2^downsample square of the region, the size rounds up
+    uint32_t downsample{0};
+    // output rows uploaded and converted per strip
+    uint32_t strip_rows{64};
+};
 class LC_TOOL_API ImageLib {
 public:
     using WriteFunc = luisa::move_only_function<void(luisa::span<std::byte const> data)>;
+    // receives the file piece by piece, data goes to [offset, offset + data.size()),
+    // the pieces arrive in increasing order except the header at offset 0, which comes last
+    using ChunkWriteFunc = luisa::move_only_function<void(size_t offset, luisa::span<std::byte const> data)>;
+    static constexpr uint32_t max_sh_order = 4;
+    using MipRange = ImageMipRange;
+    using PrefilterMode = ImagePrefilterMode;
+    using PrefilterOption = ImagePrefilterOption;
+    using ReadOption = ImageReadOption;
+    using ExrRegion = ImageExrRegion;
+    // what a file written by save_image / save_volume holds, from its header alone
+    struct ImageInfo {
+        uint3 size;
+        uint32_t mip_level;
+        PixelStorage storage;
+    };
+    enum WarmUpFlag : uint32_t {
+        WARM_UP_MIP = 1u << 0u,
+        WARM_UP_CUBEMAP = 1u << 1u,
+        WARM_UP_COMPRESS = 1u << 2u,
+        WARM_UP_SH = 1u << 3u,
+        WARM_UP_READ = 1u << 4u,
+        WARM_UP_ALL = ~0u
+    };
+    struct WarmUpStats {
+        uint32_t shader_count{0};
+        // wall time of the whole warm-up and the summed per-shader time
+        double total_ms{0};
+        double shader_ms{0};
+    };
+    // an LDR, HDR or EXR file, the decoder is chosen by the extension
+    struct ReadRequest {
+        luisa::string file_name;
+        uint32_t mip_level{1};
+        ReadOption option{};
+    };
+    // one phase over every call since the last reset_profile
+    struct PhaseStats {
+        luisa::string name;
+        uint64_t count{0};
+        double total_ms{0};
+        double max_ms{0};
+        uint64_t bytes{0};
+    };
 
 private:
     Device _device;
+    luisa::unique_ptr<imglib_detail::Profiler> _profiler;
+    // host span from construction to destruction, nothing is recorded while profiling is off
+    class ProfileSpan {
+        ImageLib *_lib;
+        luisa::string_view _name;
+        double _begin;
 
-    template<typename... T>
-    struct ShaderOptional2D {
-        using value_type = vstd::optional<Shader2D<T...>>;
+    public:
+        size_t bytes;
+        ProfileSpan(ImageLib *lib, luisa::string_view name, size_t bytes = 0) noexcept;
+        ProfileSpan(ProfileSpan const &) = delete;
+        ~ProfileSpan() noexcept;
+    };
+    // ms since the profiler was created, negative while profiling is off
+    [[nodiscard]] double profile_now() const noexcept;
+    // device span from begin (a profile_now() taken before recording the work) until the
+    // command buffer callback after the work runs
+    void profile_device(CommandBuffer &cmd_buffer, luisa::string_view name, double begin, size_t bytes) noexcept;
+
+    // compiled on first use, or ahead of time by warm_up, from any number of threads
+    template<typename S>
+    struct ShaderOptional {
+        using value_type = vstd::optional<S>;
         value_type value;
         vstd::function<void(value_type &)> init_func;
-        Shader2D<T...> &operator*() noexcept {
-            if (!value) {
-                init_func(value);
-            }
+        std::once_flag init_flag;
+        S &operator*() noexcept {
+            std::call_once(init_flag, [this] { init_func(value); });
             return *value;
         }
-        Shader2D<T...> *operator->() noexcept {
-            if (!value) {
-                init_func(value);
-            }
+        S *operator->() noexcept {
+            std::call_once(init_flag, [this] { init_func(value); });
             return value.GetPtr();
         }
     };
+    template<typename... T>
+    using ShaderOptional2D = ShaderOptional<Shader2D<T...>>;
+    template<typename... T>
+    using ShaderOptional3D = ShaderOptional<Shader3D<T...>>;
+    struct WarmUpEntry {
+        uint32_t flags;
+        luisa::string name;
+        vstd::function<void()> init;
+    };
+    luisa::vector<WarmUpEntry> _warm_up_entries;
+    template<typename Tex, typename Load>
+    Tex profile_load(luisa::string_view name, CommandBuffer &cmd_buffer, Load &&load) noexcept;
+    template<typename S>
+    void add_warm_up(uint32_t flags, luisa::string name, ShaderOptional<S> &shader) noexcept {
+        // lazy compiles show up in the profile too
+        shader.init_func = [this, span_name = luisa::format("compile.{}", name), init = std::move(shader.init_func)](auto &opt) {
+            ProfileSpan span{this, span_name};
+            init(opt);
+        };
+        _warm_up_entries.push_back(WarmUpEntry{flags, std::move(name), [&shader] { static_cast<void>(*shader); }});
+    }
     template<typename T, size_t i>
     using MipgenType = typename decltype(detail::TypeAccumulator<i, ShaderOptional2D, T>())::Type;
     std::filesystem::path _path;
@@ -54,86 +184,297 @@ private:
     MipgenType<Image<float>, 3> _mip3_shader;
     MipgenType<Image<float>, 4> _mip4_shader;
     MipgenType<Image<float>, 5> _mip5_shader;
+    // src_tex, src_size, output_texture
+    ShaderOptional2D<Image<float>, uint2, Image<float>> _mip_npot_shader;
+    // src_volume, output_volume, for even sizes
+    ShaderOptional3D<Volume<float>, Volume<float>> _mip_volume_shader;
+    // src_volume, src_size, output_volume
+    ShaderOptional3D<Volume<float>, uint3, Volume<float>> _mip_volume_npot_shader;
     // src_tex, output_texture, roughness
     ShaderOptional2D<Image<float>, float2, Image<float>, float> _refl_map_gen;
+    // src_chain, samples, sample_count, src_size, output_texture
+    ShaderOptional2D<BindlessArray, Buffer<float4>, uint, uint2, Image<float>> _refl_fis_gen;
+    // src_tex, output_texture of another storage
+    ShaderOptional2D<Image<float>, Image<float>> _convert_shader;
+    // raw_planes, plane_offsets, plane_types, src_size, valid_rect, scale, row_offset, output_texture
+    ShaderOptional2D<Buffer<uint>, uint4, uint4, uint2, uint4, uint, uint, Image<float>> _exr_strip_shader;
+    // src_tex, src_size, block_partials
+    ShaderOptional2D<Image<float>, uint2, Buffer<float4>> _sh_project_shader[max_sh_order];
+    // block_partials, block_count, coeff_count, output_coeffs
+    ShaderOptional2D<Buffer<float4>, uint, uint, Buffer<float4>> _sh_reduce_shader;
+    // src_lat_long, lod, face_size, output_cube
+    ShaderOptional2D<BindlessArray, float, uint, Image<float>> _equirect_to_cube_shader;
+    // src_cube_chain, samples, sample_count, src_face_size, max_lod, output_cube
+    ShaderOptional2D<BindlessArray, Buffer<float4>, uint, uint, float, Image<float>> _cube_prefilter_shader;
+    // src_tex, output_blocks, src_size
+    ShaderOptional2D<Image<float>, Buffer<uint2>, uint2> _bc1_shader;
+    ShaderOptional2D<Image<float>, Buffer<uint4>, uint2> _bc3_shader;
+    ShaderOptional2D<Image<float>, Buffer<uint2>, uint2> _bc4_shader;
+    ShaderOptional2D<Image<float>, Buffer<uint4>, uint2> _bc5_shader;
+    ShaderOptional2D<Image<float>, Buffer<uint4>, uint2> _bc6_shader;
+    ShaderOptional2D<Image<float>, Buffer<uint4>, uint2> _bc7_shader;
     ImageLib() = delete;
-    Image<float> load_float_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept;
-    Image<int32_t> load_int_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept;
-    Image<uint32_t> load_uint_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept;
-    Volume<float> load_float_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept;
-    Volume<int32_t> load_int_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept;
-    Volume<uint32_t> load_uint_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept;
-    size_t header_size() noexcept;
+    Image<float> load_float_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Image<int32_t> load_int_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Image<uint32_t> load_uint_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Volume<float> load_float_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Volume<int32_t> load_int_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Volume<uint32_t> load_uint_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Image<float> load_float_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Image<int32_t> load_int_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Image<uint32_t> load_uint_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Volume<float> load_float_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Volume<int32_t> load_int_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Volume<uint32_t> load_uint_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept;
+    Image<float> load_float_image(MappedFile &&file, CommandBuffer &cmd_buffer, MipRange range, luisa::string &error) noexcept;
+    Image<int32_t> load_int_image(MappedFile &&file, CommandBuffer &cmd_buffer, MipRange range, luisa::string &error) noexcept;
+    Image<uint32_t> load_uint_image(MappedFile &&file, CommandBuffer &cmd_buffer, MipRange range, luisa::string &error) noexcept;
+    size_t header_size(uint32_t mip) noexcept;
     void save_header(
         luisa::span<std::byte> data,
         uint32_t width, uint32_t height, uint32_t volume,
         PixelStorage storage,
-        uint32_t mip) noexcept;
+        uint32_t mip,
+        bool checksum) noexcept;
+    void write_header(
+        luisa::span<std::byte> data,
+        uint32_t width, uint32_t height, uint32_t volume,
+        PixelStorage storage,
+        uint32_t mip,
+        luisa::span<uint64_t const> checksums) noexcept;
+    struct StreamingSave {
+        ChunkWriteFunc func;
+        uint3 size;
+        PixelStorage storage;
+        uint32_t mip;
+        bool checksum;
+        // running checksum of every level
+        luisa::vector<uint64_t> checksums;
+    };
+    luisa::vector<std::byte> acquire_staging(StagingPool &pool, size_t size, CommandBuffer &cmd_buffer) noexcept;
+    void write_chunk(StreamingSave &save, uint32_t level, size_t offset, luisa::span<std::byte const> data) noexcept;
+    void finish_save(StreamingSave &save) noexcept;
+    // Mips that fit in a pool chunk are read back directly, larger ones go through a device
+    // buffer and are read back in chunk-sized strips, so host memory stays within the pool budget
+    template<typename Tex>
+    void save_streaming(Tex const &image, uint3 size, CommandBuffer &cmd_buffer, StagingPool &pool, ChunkWriteFunc &&func, bool checksum) noexcept {
+        auto mip = image.mip_levels();
+        auto save = luisa::make_shared<StreamingSave>();
+        save->func = std::move(func);
+        save->size = size;
+        save->storage = image.storage();
+        save->mip = mip;
+        save->checksum = checksum;
+        auto begin = profile_now();
+        auto offset = header_size(mip);
+        // coarsest mip first
+        for (auto i : vstd::range(mip)) {
+            auto level = static_cast<uint32_t>(mip - 1 - i);
+            auto view = image.view(level);
+            auto mip_size = view.byte_size();
+            if (mip_size <= pool.chunk_size()) {
+                auto chunk = acquire_staging(pool, mip_size, cmd_buffer);
+                cmd_buffer << view.copy_to(chunk.data())
+                           << [this, save, &pool, chunk = std::move(chunk), level, offset]() mutable {
+                                  write_chunk(*save, level, offset, chunk);
+                                  pool.release(std::move(chunk));
+                              };
+            } else {
+                auto device_buffer = _device.create_buffer<uint>((mip_size + sizeof(uint) - 1) / sizeof(uint));
+                cmd_buffer << view.copy_to(device_buffer.view());
+                for (size_t strip_offset = 0; strip_offset < mip_size; strip_offset += pool.chunk_size()) {
+                    auto strip_size = std::min(pool.chunk_size(), mip_size - strip_offset);
+                    auto strip_elements = (strip_size + sizeof(uint) - 1) / sizeof(uint);
+                    auto chunk = acquire_staging(pool, strip_elements * sizeof(uint), cmd_buffer);
+                    cmd_buffer << device_buffer.view(strip_offset / sizeof(uint), strip_elements).copy_to(chunk.data())
+                               << [this, save, &pool, chunk = std::move(chunk), level, offset = offset + strip_offset, strip_size]() mutable {
+                                      write_chunk(*save, level, offset, {chunk.data(), strip_size});
+                                      pool.release(std::move(chunk));
+                                  };
+                }
+                cmd_buffer << [device_buffer = std::move(device_buffer)] {};
+            }
+            offset += mip_size;
+        }
+        profile_device(cmd_buffer, "save.readback", begin, image.byte_size());
+        cmd_buffer << [this, save] { finish_save(*save); };
+    }
+    void init_sh_shaders() noexcept;
+    void init_cube_shaders() noexcept;
+    void init_exr_shaders() noexcept;
+    Image<float> upload_decoded(imglib_detail::DecodedImage &&decoded, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option = {}) noexcept;
+    // the strip upload of read_exr_region, the planes are copied to staging before it returns
+    Image<float> upload_exr(imglib_detail::DecodedExr const &exr, luisa::string_view file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ExrRegion region, ReadOption option) noexcept;
 
 public:
     ImageLib(Device device, luisa::string shader_dir) noexcept;
     ImageLib(ImageLib const &) = delete;
     ImageLib(ImageLib &&) = delete;
+    ~ImageLib() noexcept;
+    [[nodiscard]] Device &device() noexcept { return _device; }
     template<typename T>
         requires(is_legal_image_element<T>)
-    Image<T> load_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
+    Image<T> load_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range = {}) noexcept {
         if constexpr (std::is_same_v<T, float>) {
-            return load_float_image(bin_stream, cmd_buffer);
+            return load_float_image(bin_stream, cmd_buffer, range);
         } else if constexpr (std::is_same_v<T, int32_t>) {
-            return load_int_image(bin_stream, cmd_buffer);
+            return load_int_image(bin_stream, cmd_buffer, range);
         } else {
-            return load_uint_image(bin_stream, cmd_buffer);
+            return load_uint_image(bin_stream, cmd_buffer, range);
         }
     }
+    // Memory-map the file and upload every mip directly from the mapping,
+    // the mapping is released by a command buffer callback after the copies finished
     template<typename T>
         requires(is_legal_image_element<T>)
-    Volume<T> load_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
+    Image<T> load_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range = {}) noexcept {
         if constexpr (std::is_same_v<T, float>) {
-            return load_float_image(bin_stream, cmd_buffer);
+            return load_float_image(path, cmd_buffer, range);
         } else if constexpr (std::is_same_v<T, int32_t>) {
-            return load_int_image(bin_stream, cmd_buffer);
+            return load_int_image(path, cmd_buffer, range);
         } else {
-            return load_uint_image(bin_stream, cmd_buffer);
+            return load_uint_image(path, cmd_buffer, range);
         }
     }
+    // Upload from a file the caller has already mapped, the mapping is released the same way.
+    // A truncated or corrupt file gives an empty image and the reason in error instead of an abort
     template<typename T>
-    void save_image(Image<T> const &image, CommandBuffer &cmd_buffer, WriteFunc &&func) noexcept {
+        requires(is_legal_image_element<T>)
+    Image<T> load_image(MappedFile &&file, CommandBuffer &cmd_buffer, luisa::string &error, MipRange range = {}) noexcept {
+        if constexpr (std::is_same_v<T, float>) {
+            return load_float_image(std::move(file), cmd_buffer, range, error);
+        } else if constexpr (std::is_same_v<T, int32_t>) {
+            return load_int_image(std::move(file), cmd_buffer, range, error);
+        } else {
+            return load_uint_image(std::move(file), cmd_buffer, range, error);
+        }
+    }
+    template<typename T>
+        requires(is_legal_image_element<T>)
+    Volume<T> load_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range = {}) noexcept {
+        if constexpr (std::is_same_v<T, float>) {
+            return load_float_volume(bin_stream, cmd_buffer, range);
+        } else if constexpr (std::is_same_v<T, int32_t>) {
+            return load_int_volume(bin_stream, cmd_buffer, range);
+        } else {
+            return load_uint_volume(bin_stream, cmd_buffer, range);
+        }
+    }
+    template<typename T>
+        requires(is_legal_image_element<T>)
+    Volume<T> load_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range = {}) noexcept {
+        if constexpr (std::is_same_v<T, float>) {
+            return load_float_volume(path, cmd_buffer, range);
+        } else if constexpr (std::is_same_v<T, int32_t>) {
+            return load_int_volume(path, cmd_buffer, range);
+        } else {
+            return load_uint_volume(path, cmd_buffer, range);
+        }
+    }
+    ImageInfo read_image_info(std::filesystem::path const &path) noexcept;
+    template<typename T>
+    void save_image(Image<T> const &image, CommandBuffer &cmd_buffer, WriteFunc &&func, bool checksum = false) noexcept {
+        auto begin = profile_now();
         luisa::vector<std::byte> bytes;
-        auto header = header_size();
+        auto mip = image.mip_levels();
+        auto header = header_size(mip);
         bytes.push_back_uninitialized(header + image.byte_size());
         auto ptr = bytes.data() + header;
-        for (auto i : vstd::range(image.mip_levels())) {
-            auto view = image.view(i);
+        // coarsest mip first
+        for (auto i : vstd::range(mip)) {
+            auto view = image.view(mip - 1 - i);
             cmd_buffer << view.copy_to(ptr);
             ptr += view.byte_size();
         }
-
-        cmd_buffer << [this, func = std::move(func), bytes = std::move(bytes), size = image.size(), storage = image.storage(), mip = image.mip_levels()]() mutable {
-            save_header(bytes, size.x, size.y, 1, storage, mip);
+        profile_device(cmd_buffer, "save.readback", begin, image.byte_size());
+        cmd_buffer << [this, func = std::move(func), bytes = std::move(bytes), size = image.size(), storage = image.storage(), mip, checksum]() mutable {
+            save_header(bytes, size.x, size.y, 1, storage, mip, checksum);
+            ProfileSpan span{this, "save.write", bytes.size()};
             func(bytes);
         };
     }
     template<typename T>
-    void save_volume(Volume<T> const &image, CommandBuffer &cmd_buffer, WriteFunc &&func) noexcept {
+    void save_volume(Volume<T> const &image, CommandBuffer &cmd_buffer, WriteFunc &&func, bool checksum = false) noexcept {
+        auto begin = profile_now();
         luisa::vector<std::byte> bytes;
-        auto header = header_size();
+        auto mip = image.mip_levels();
+        auto header = header_size(mip);
         bytes.push_back_uninitialized(header + image.byte_size());
         auto ptr = bytes.data() + header;
-        for (auto i : vstd::range(image.mip_levels())) {
-            auto view = image.view(i);
+        // coarsest mip first
+        for (auto i : vstd::range(mip)) {
+            auto view = image.view(mip - 1 - i);
             cmd_buffer << view.copy_to(ptr);
             ptr += view.byte_size();
         }
-        cmd_buffer << [this, func = std::move(func), bytes = std::move(bytes), size = image.size(), storage = image.storage(), mip = image.mip_levels()]() mutable {
-            save_header(bytes, size.x, size.y, size.z, storage, mip);
+        profile_device(cmd_buffer, "save.readback", begin, image.byte_size());
+        cmd_buffer << [this, func = std::move(func), bytes = std::move(bytes), size = image.size(), storage = image.storage(), mip, checksum]() mutable {
+            save_header(bytes, size.x, size.y, size.z, storage, mip, checksum);
+            ProfileSpan span{this, "save.write", bytes.size()};
             func(bytes);
         };
     }
-    Image<float> read_ldr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level) noexcept;
-    Image<float> read_hdr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level) noexcept;
-    Image<float> read_exr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level) noexcept;
-    Image<float> read_exr_cubemap(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, float roughness) noexcept;
+    // Streaming save, host memory is bounded by the pool budget whatever the image size.
+    // If the pool is exhausted the recorded work is committed and the call blocks until
+    // earlier pieces are written, the pool must outlive the command buffer's execution.
+    template<typename T>
+    void save_image(Image<T> const &image, CommandBuffer &cmd_buffer, StagingPool &pool, ChunkWriteFunc &&func, bool checksum = false) noexcept {
+        auto size = image.size();
+        save_streaming(image, make_uint3(size, 1u), cmd_buffer, pool, std::move(func), checksum);
+    }
+    template<typename T>
+    void save_volume(Volume<T> const &image, CommandBuffer &cmd_buffer, StagingPool &pool, ChunkWriteFunc &&func, bool checksum = false) noexcept {
+        save_streaming(image, image.size(), cmd_buffer, pool, std::move(func), checksum);
+    }
+    Image<float> read_ldr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option = {}) noexcept;
+    Image<float> read_hdr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option = {}) noexcept;
+    Image<float> read_exr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option = {}) noexcept;
+    // tinyexr decodes the whole image into planar channels in their stored precision (half stays half),
+    // which stay on the host for the call. The rows of the region are then uploaded as stored, one strip at
+    // a time through a bounded staging pool, and converted to RGBA and box-downsampled by 2^downsample on the
+    // device, so no RGBA float copy of the image is built on the host. read_exr, read_batch and the EXR
+    // environment map readers are this call with the whole image, so they share channels and windows.
+    Image<float> read_exr_region(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ExrRegion region = {}, ReadOption option = {}) noexcept;
+    // Compile every shader selected by flags (WarmUpFlag bits) in parallel on thread_count threads
+    // (0 for all cores) and block until done. Compiled shaders are cached under shader_dir, keyed by
+    // the kernel hash, so the stats show the cold-start cost on the first run and the warm-start cost after.
+    WarmUpStats warm_up(uint32_t flags = WARM_UP_ALL, uint32_t thread_count = 0) noexcept;
+    // Record host time and bytes of every phase (decode, allocation, upload, shader compile,
+    // generate and save) and, for device work, the time from recording to completion.
+    // Off by default, a disabled profiler costs one atomic load per phase.
+    void set_profiling(bool enabled) noexcept;
+    [[nodiscard]] luisa::vector<PhaseStats> profile_stats() const noexcept;
+    void reset_profile() noexcept;
+    // Chrome trace event JSON of the recorded spans, for chrome://tracing or Perfetto
+    bool dump_trace(std::filesystem::path const &path) const noexcept;
+    // called on the read_batch thread for each file once its upload is recorded, in completion order;
+    // work recorded on the command buffer here is committed with the upload. error is empty unless
+    // the file could not be decoded, then image is empty
+    using ReadyFunc = luisa::move_only_function<void(size_t index, Image<float> const &image, luisa::string_view error)>;
+    // Decode the files on thread_count worker threads (0 for all cores) while the calling thread
+    // enqueues the upload and mip generation of each file as soon as it is decoded and commits,
+    // so decoding overlaps with the device copies. Images are returned in request order; a file
+    // that can not be decoded is left empty and reported to on_ready, the other files are still read.
+    luisa::vector<Image<float>> read_batch(luisa::span<ReadRequest const> requests, CommandBuffer &cmd_buffer, uint32_t thread_count = 0, ReadyFunc &&on_ready = {}) noexcept;
+    Image<float> read_exr_cubemap(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, float roughness, PrefilterOption option = {}) noexcept;
+    // Box-filter the full chain from mip 0, any mip count and any (non-power-of-two) size,
+    // any uncompressed storage (BYTE*, HALF*, FLOAT*) as the texel reads and writes convert through float4
     void generate_mip(Image<float> const &img, CommandBuffer &cmd_buffer) noexcept;
-    void generate_cubemap_mip(Image<float> const &img, CommandBuffer &cmd_buffer, float roughness) noexcept;
+    // 3D box filter of the full chain from mip 0, one dispatch per level, any size
+    void generate_volume_mip(Volume<float> const &volume, CommandBuffer &cmd_buffer) noexcept;
+    // Encode every mip of img into a new image of a block-compressed storage (BC1, BC3, BC4, BC5, BC6, BC7),
+    // the size of img must be a multiple of 4
+    Image<float> compress(Image<float> const &img, PixelStorage target, CommandBuffer &cmd_buffer) noexcept;
+    // Cube maps are one image of face_size x (6 * face_size), faces stacked vertically in the order
+    // +X, -X, +Y, -Y, +Z, -Z. face_size must be a power of two so every mip keeps six whole faces.
+    // Resample a lat-long map into mip 0 of a new cube map
+    Image<float> equirect_to_cube(Image<float> const &equirect, uint32_t face_size, uint32_t mip_level, CommandBuffer &cmd_buffer) noexcept;
+    // GGX prefilter of every mip of a cube map from its mip 0, using the roughness schedule of generate_cubemap_mip
+    void generate_cube_prefilter(Image<float> const &cube, CommandBuffer &cmd_buffer, float roughness, PrefilterOption option = {}) noexcept;
+    Image<float> read_exr_cube(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t face_size, uint32_t mip_level, float roughness, PrefilterOption option = {}) noexcept;
+    // Project a lat-long environment map onto real SH of bands [0, order), order <= max_sh_order.
+    // Returns order * order coefficients, rgb in xyz, in a single block-reduction pass plus a tiny sum.
+    Buffer<float4> project_sh(Image<float> const &img, uint32_t order, CommandBuffer &cmd_buffer) noexcept;
+    void generate_cubemap_mip(Image<float> const &img, CommandBuffer &cmd_buffer, float roughness, PrefilterOption option = {}) noexcept;
 };
 }// namespace luisa::compute
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <tools/image_lib.h>
+#include <core/logging.h>
+#include "image_decode.h"
+#include "exr_decode.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace luisa::compute {
+luisa::vector<Image<float>> ImageLib::read_batch(luisa::span<ReadRequest const> requests, CommandBuffer &cmd_buffer, uint32_t thread_count, ReadyFunc &&on_ready) noexcept {
+    // EXR files go through the strip reader of read_exr, everything else through upload_decoded;
+    // a file that can not be decoded only carries the error
+    struct Decoded {
+        size_t index;
+        imglib_detail::DecodedImage image;
+        luisa::unique_ptr<imglib_detail::DecodedExr> exr;
+        luisa::string error;
+    };
+    luisa::vector<Image<float>> images;
+    images.resize(requests.size());
+    if (requests.empty()) {
+        return images;
+    }
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    thread_count = std::min<uint32_t>(thread_count, requests.size());
+    std::atomic_size_t next_request{0};
+    std::mutex mtx;
+    std::condition_variable cv;
+    luisa::vector<Decoded> decoded;
+    luisa::vector<std::thread> workers;
+    workers.reserve(thread_count);
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back([&] {
+            while (true) {
+                auto index = next_request.fetch_add(1, std::memory_order_relaxed);
+                if (index >= requests.size()) {
+                    return;
+                }
+                auto &&request = requests[index];
+                Decoded result{.index = index};
+                {
+                    ProfileSpan span{this, "decode"};
+                    if (imglib_detail::is_exr_file(request.file_name)) {
+                        result.exr = imglib_detail::decode_exr(request.file_name, result.error);
+                    } else {
+                        result.image = imglib_detail::decode_file(request.file_name, result.error, request.option.native_channels);
+                    }
+                }
+                {
+                    std::lock_guard lck{mtx};
+                    decoded.emplace_back(std::move(result));
+                }
+                cv.notify_one();
+            }
+        });
+    }
+    // the command buffer is only touched by this thread, each upload is submitted as soon as it is ready
+    luisa::vector<Decoded> ready;
+    for (size_t finished = 0; finished < requests.size();) {
+        {
+            std::unique_lock lck{mtx};
+            cv.wait(lck, [&] { return !decoded.empty(); });
+            std::swap(ready, decoded);
+        }
+        for (auto &&[index, image, exr, error] : ready) {
+            auto &&request = requests[index];
+            if (exr != nullptr) {
+                images[index] = upload_exr(*exr, request.file_name, cmd_buffer, request.mip_level, {}, request.option);
+                exr.reset();
+            } else if (image.data != nullptr) {
+                images[index] = upload_decoded(std::move(image), cmd_buffer, request.mip_level, request.option);
+            }
+            if (on_ready) {
+                on_ready(index, images[index], error);
+            }
+        }
+        finished += ready.size();
+        ready.clear();
+        cmd_buffer << commit();
+    }
+    for (auto &&i : workers) {
+        i.join();
+    }
+    return images;
+}
+}// namespace luisa::compute
@@ -0,0 +1,363 @@
+#include <tools/image_lib.h>
+#include <dsl/syntax.h>
+#include <dsl/sugar.h>
+#include <core/logging.h>
+#include "block_compress.h"
+#include "shader_cache.h"
+
+namespace luisa::compute {
+namespace imglib_detail {
+// 128-bit block assembled from statically placed bit fields
+struct BlockBits {
+    UInt words[4] = {0u, 0u, 0u, 0u};
+    void put(Expr<uint> value, uint32_t offset, uint32_t bits) noexcept {
+        auto mask = bits == 32 ? 0xffffffffu : ((1u << bits) - 1u);
+        auto v = value & mask;
+        auto word = offset / 32;
+        auto shift = offset % 32;
+        words[word] = words[word] | (v << shift);
+        if (shift + bits > 32) {
+            words[word + 1] = words[word + 1] | (v >> (32 - shift));
+        }
+    }
+};
+static void load_block(ImageVar<float> const &img, Expr<uint2> size, Float4 (&texels)[16]) noexcept {
+    auto base = dispatch_id().xy() * make_uint2(4u);
+    for (auto i : vstd::range(16u)) {
+        auto coord = min(base + make_uint2(static_cast<uint>(i % 4u), static_cast<uint>(i / 4u)), size - make_uint2(1u));
+        texels[i] = img.read(coord);
+    }
+}
+static UInt block_index() noexcept {
+    auto coord = dispatch_id().xy();
+    return coord.y * dispatch_size().x + coord.x;
+}
+// position of v along [e0, e1], quantized to [0, steps]
+static UInt project_index(Expr<float4> v, Expr<float4> e0, Expr<float4> e1, uint32_t steps) noexcept {
+    auto dir = e1 - e0;
+    auto len = dot(dir, dir);
+    auto t = select(dot(v - e0, dir) / len, 0.0f, len < 1e-8f);
+    return round(saturate(t) * float(steps)).cast<uint>();
+}
+static UInt pack_565(Expr<float3> c) noexcept {
+    auto q = round(saturate(c) * make_float3(31.0f, 63.0f, 31.0f)).cast<uint3>();
+    return (q.x << 11u) | (q.y << 5u) | q.z;
+}
+static Float3 unpack_565(Expr<uint> c) noexcept {
+    return make_float3(make_uint3(c >> 11u, (c >> 5u) & 63u, c & 31u)) / make_float3(31.0f, 63.0f, 31.0f);
+}
+// BC1 color block, always in the four-color mode so it can be reused by BC3
+static void encode_color(Float4 (&texels)[16], BlockBits &bits, uint32_t offset) noexcept {
+    Float3 lo = saturate(texels[0].xyz());
+    Float3 hi = lo;
+    for (auto i : vstd::range(1u, 16u)) {
+        lo = min(lo, saturate(texels[i].xyz()));
+        hi = max(hi, saturate(texels[i].xyz()));
+    }
+    // inset the bounding box to reduce the error of the extreme colors
+    auto inset = (hi - lo) * (1.0f / 16.0f);
+    UInt c0 = pack_565(hi - inset);
+    UInt c1 = pack_565(lo + inset);
+    // c0 > c1 selects the four-color mode
+    auto swap = c0 < c1;
+    UInt tmp = c0;
+    c0 = select(c0, c1, swap);
+    c1 = select(c1, tmp, swap);
+    auto e0 = make_float4(unpack_565(c0), 0.0f);
+    auto e1 = make_float4(unpack_565(c1), 0.0f);
+    bits.put(c0, offset, 16);
+    bits.put(c1, offset + 16, 16);
+    for (auto i : vstd::range(16u)) {
+        auto k = project_index(make_float4(saturate(texels[i].xyz()), 0.0f), e0, e1, 3);
+        // linear order e0, 2/3 e0 + 1/3 e1, 1/3 e0 + 2/3 e1, e1 -> 0, 2, 3, 1
+        auto code = select(select(k + 1u, 1u, k == 3u), 0u, k == 0u);
+        bits.put(select(code, 0u, c0 == c1), offset + 32 + i * 2, 2);
+    }
+}
+// BC4 single channel block in the eight-value mode
+static void encode_channel(Float (&values)[16], BlockBits &bits, uint32_t offset) noexcept {
+    Float lo = saturate(values[0]);
+    Float hi = lo;
+    for (auto i : vstd::range(1u, 16u)) {
+        lo = min(lo, saturate(values[i]));
+        hi = max(hi, saturate(values[i]));
+    }
+    auto a0 = round(hi * 255.0f).cast<uint>();
+    auto a1 = round(lo * 255.0f).cast<uint>();
+    auto e0 = make_float4(a0.cast<float>() / 255.0f, 0.0f, 0.0f, 0.0f);
+    auto e1 = make_float4(a1.cast<float>() / 255.0f, 0.0f, 0.0f, 0.0f);
+    bits.put(a0, offset, 8);
+    bits.put(a1, offset + 8, 8);
+    for (auto i : vstd::range(16u)) {
+        auto k = project_index(make_float4(saturate(values[i]), 0.0f, 0.0f, 0.0f), e0, e1, 7);
+        // linear order a0, 6/7 a0 + 1/7 a1, ..., a1 -> 0, 2, 3, 4, 5, 6, 7, 1
+        auto code = select(select(k + 1u, 1u, k == 7u), 0u, k == 0u);
+        bits.put(code, offset + 16 + i * 3, 3);
+    }
+}
+static void encode_bc1(ImageVar<float> img, BufferVar<uint2> blocks, UInt2 size) noexcept {
+    Float4 texels[16];
+    load_block(img, size, texels);
+    BlockBits bits;
+    encode_color(texels, bits, 0);
+    blocks.write(block_index(), make_uint2(bits.words[0], bits.words[1]));
+}
+static void encode_bc4(ImageVar<float> img, BufferVar<uint2> blocks, UInt2 size) noexcept {
+    Float4 texels[16];
+    load_block(img, size, texels);
+    Float values[16];
+    for (auto i : vstd::range(16u)) {
+        values[i] = texels[i].x;
+    }
+    BlockBits bits;
+    encode_channel(values, bits, 0);
+    blocks.write(block_index(), make_uint2(bits.words[0], bits.words[1]));
+}
+static void encode_bc3(ImageVar<float> img, BufferVar<uint4> blocks, UInt2 size) noexcept {
+    Float4 texels[16];
+    load_block(img, size, texels);
+    Float values[16];
+    for (auto i : vstd::range(16u)) {
+        values[i] = texels[i].w;
+    }
+    BlockBits bits;
+    encode_channel(values, bits, 0);
+    encode_color(texels, bits, 64);
+    blocks.write(block_index(), make_uint4(bits.words[0], bits.words[1], bits.words[2], bits.words[3]));
+}
+static void encode_bc5(ImageVar<float> img, BufferVar<uint4> blocks, UInt2 size) noexcept {
+    Float4 texels[16];
+    load_block(img, size, texels);
+    Float red[16];
+    Float green[16];
+    for (auto i : vstd::range(16u)) {
+        red[i] = texels[i].x;
+        green[i] = texels[i].y;
+    }
+    BlockBits bits;
+    encode_channel(red, bits, 0);
+    encode_channel(green, bits, 64);
+    blocks.write(block_index(), make_uint4(bits.words[0], bits.words[1], bits.words[2], bits.words[3]));
+}
+// write 16 four-bit indices with the one-bit-shorter anchor index first
+static void put_indices(UInt (&indices)[16], BlockBits &bits, uint32_t offset) noexcept {
+    bits.put(indices[0], offset, 3);
+    for (auto i : vstd::range(1u, 16u)) {
+        bits.put(indices[i], offset + 3 + (i - 1) * 4, 4);
+    }
+}
+// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with unique p-bits, 4-bit indices
+static void encode_bc7(ImageVar<float> img, BufferVar<uint4> blocks, UInt2 size) noexcept {
+    Float4 texels[16];
+    load_block(img, size, texels);
+    Float4 lo = saturate(texels[0]);
+    Float4 hi = lo;
+    for (auto i : vstd::range(1u, 16u)) {
+        lo = min(lo, saturate(texels[i]));
+        hi = max(hi, saturate(texels[i]));
+    }
+    auto inset = (hi - lo) * (1.0f / 32.0f);
+    // pick the p-bit with the smaller quantization error
+    auto quantize = [](Expr<float4> e, UInt4 &q, UInt &p) noexcept {
+        auto v = e * 255.0f;
+        auto q0 = clamp(round(v * 0.5f), 0.0f, 127.0f);
+        auto q1 = clamp(round((v - 1.0f) * 0.5f), 0.0f, 127.0f);
+        auto d0 = q0 * 2.0f - v;
+        auto d1 = q1 * 2.0f + 1.0f - v;
+        auto use_one = dot(d1, d1) < dot(d0, d0);
+        q = select(q0, q1, use_one).cast<uint4>();
+        p = select(0u, 1u, use_one);
+    };
+    UInt4 q0, q1;
+    UInt p0, p1;
+    quantize(hi - inset, q0, p0);
+    quantize(lo + inset, q1, p1);
+    Float4 e0 = make_float4((q0 << 1u) | make_uint4(p0)) / 255.0f;
+    Float4 e1 = make_float4((q1 << 1u) | make_uint4(p1)) / 255.0f;
+    UInt indices[16];
+    for (auto i : vstd::range(16u)) {
+        indices[i] = project_index(saturate(texels[i]), e0, e1, 15);
+    }
+    // the anchor index must have its highest bit clear, otherwise swap the endpoints
+    auto flip = indices[0] >= 8u;
+    UInt4 tmp_q = q0;
+    UInt tmp_p = p0;
+    q0 = select(q0, q1, flip);
+    q1 = select(q1, tmp_q, flip);
+    p0 = select(p0, p1, flip);
+    p1 = select(p1, tmp_p, flip);
+    for (auto i : vstd::range(16u)) {
+        indices[i] = select(indices[i], 15u - indices[i], flip);
+    }
+    BlockBits bits;
+    bits.put(1u << 6u, 0, 7);
+    bits.put(q0.x, 7, 7);
+    bits.put(q1.x, 14, 7);
+    bits.put(q0.y, 21, 7);
+    bits.put(q1.y, 28, 7);
+    bits.put(q0.z, 35, 7);
+    bits.put(q1.z, 42, 7);
+    bits.put(q0.w, 49, 7);
+    bits.put(q1.w, 56, 7);
+    bits.put(p0, 63, 1);
+    bits.put(p1, 64, 1);
+    put_indices(indices, bits, 65);
+    blocks.write(block_index(), make_uint4(bits.words[0], bits.words[1], bits.words[2], bits.words[3]));
+}
+// bit pattern of a non-negative half, which is the space BC6H interpolates in
+static Float3 half_bits(Expr<float3> x) noexcept {
+    auto f = clamp(x, 0.0f, 65504.0f);
+    auto bits = f.as<uint3>();
+    auto normal = (((bits >> 23u) - 112u) << 10u) | ((bits >> 13u) & 0x3ffu);
+    auto denormal = round(f * 16777216.0f).cast<uint3>();
+    return make_float3(select(normal, denormal, f < 6.103515625e-5f));
+}
+// BC6H (unsigned) mode 11: one region, untransformed 10-bit endpoints, 4-bit indices
+static void encode_bc6(ImageVar<float> img, BufferVar<uint4> blocks, UInt2 size) noexcept {
+    Float4 texels[16];
+    load_block(img, size, texels);
+    Float4 values[16];
+    for (auto i : vstd::range(16u)) {
+        values[i] = make_float4(half_bits(texels[i].xyz()), 0.0f);
+    }
+    Float4 lo = values[0];
+    Float4 hi = lo;
+    for (auto i : vstd::range(1u, 16u)) {
+        lo = min(lo, values[i]);
+        hi = max(hi, values[i]);
+    }
+    // a 10-bit endpoint c decodes to the half pattern 31 * c + 15
+    auto quantize = [](Expr<float4> e) noexcept {
+        return clamp(round(max(e - 15.0f, 0.0f) / 31.0f), 0.0f, 1023.0f).cast<uint4>();
+    };
+    UInt4 q0 = quantize(lo);
+    UInt4 q1 = quantize(hi);
+    auto e0 = make_float4(q0) * 31.0f + 15.0f;
+    auto e1 = make_float4(q1) * 31.0f + 15.0f;
+    UInt indices[16];
+    for (auto i : vstd::range(16u)) {
+        indices[i] = project_index(values[i], e0, e1, 15);
+    }
+    auto flip = indices[0] >= 8u;
+    UInt4 tmp = q0;
+    q0 = select(q0, q1, flip);
+    q1 = select(q1, tmp, flip);
+    for (auto i : vstd::range(16u)) {
+        indices[i] = select(indices[i], 15u - indices[i], flip);
+    }
+    BlockBits bits;
+    bits.put(3u, 0, 5);
+    bits.put(q0.x, 5, 10);
+    bits.put(q0.y, 15, 10);
+    bits.put(q0.z, 25, 10);
+    bits.put(q1.x, 35, 10);
+    bits.put(q1.y, 45, 10);
+    bits.put(q1.z, 55, 10);
+    put_indices(indices, bits, 65);
+    blocks.write(block_index(), make_uint4(bits.words[0], bits.words[1], bits.words[2], bits.words[3]));
+}
+void compile_bc_shader(vstd::optional<BC8Shader> &shader, Device &device, PixelStorage storage, std::filesystem::path const &dir) noexcept {
+    switch (storage) {
+        case PixelStorage::BC1:
+            compile_cached(shader, device, Kernel2D{encode_bc1}, dir, "__bc1_encode");
+            return;
+        case PixelStorage::BC4:
+            compile_cached(shader, device, Kernel2D{encode_bc4}, dir, "__bc4_encode");
+            return;
+        default:
+            LUISA_ERROR("Storage is not an 8-byte block format.");
+            return;
+    }
+}
+void compile_bc_shader(vstd::optional<BC16Shader> &shader, Device &device, PixelStorage storage, std::filesystem::path const &dir) noexcept {
+    switch (storage) {
+        case PixelStorage::BC3:
+            compile_cached(shader, device, Kernel2D{encode_bc3}, dir, "__bc3_encode");
+            return;
+        case PixelStorage::BC5:
+            compile_cached(shader, device, Kernel2D{encode_bc5}, dir, "__bc5_encode");
+            return;
+        case PixelStorage::BC6:
+            compile_cached(shader, device, Kernel2D{encode_bc6}, dir, "__bc6_encode");
+            return;
+        case PixelStorage::BC7:
+            compile_cached(shader, device, Kernel2D{encode_bc7}, dir, "__bc7_encode");
+            return;
+        default:
+            LUISA_ERROR("Storage is not a 16-byte block format.");
+            return;
+    }
+}
+bool is_block_compressed(PixelStorage storage) noexcept {
+    switch (storage) {
+        case PixelStorage::BC1:
+        case PixelStorage::BC3:
+        case PixelStorage::BC4:
+        case PixelStorage::BC5:
+        case PixelStorage::BC6:
+        case PixelStorage::BC7:
+            return true;
+        default:
+            return false;
+    }
+}
+// all mips are encoded into one staging buffer, which is released after the copies
+template<typename Block, typename ShaderType>
+static void encode_mips(Device &device, ShaderType &shader, Image<float> const &img, Image<float> const &dst, CommandBuffer &cmd_buffer) noexcept {
+    luisa::vector<size_t> offsets;
+    size_t block_count = 0;
+    for (auto i : vstd::range(img.mip_levels())) {
+        auto size = img.view(i).size();
+        offsets.push_back(block_count);
+        block_count += ((size.x + 3u) / 4u) * ((size.y + 3u) / 4u);
+    }
+    auto buffer = device.create_buffer<Block>(block_count);
+    for (auto i : vstd::range(img.mip_levels())) {
+        auto src_view = img.view(i);
+        auto size = src_view.size();
+        auto blocks = make_uint2((size.x + 3u) / 4u, (size.y + 3u) / 4u);
+        auto block_view = buffer.view(offsets[i], blocks.x * blocks.y);
+        cmd_buffer << (*shader)(src_view, block_view, size).dispatch(blocks)
+                   << dst.view(i).copy_from(block_view);
+    }
+    cmd_buffer << [buffer = std::move(buffer)] {};
+}
+}// namespace imglib_detail
+Image<float> ImageLib::compress(Image<float> const &img, PixelStorage target, CommandBuffer &cmd_buffer) noexcept {
+    using namespace imglib_detail;
+    auto size = img.size();
+    if (size.x % 4 != 0 || size.y % 4 != 0) {
+        LUISA_ERROR("Block compression requires a size multiple of 4, got {}x{}.", size.x, size.y);
+    }
+    if (is_block_compressed(img.storage())) {
+        LUISA_ERROR("Can not compress an image that is already block-compressed.");
+    }
+    auto begin = profile_now();
+    auto dst = _device.create_image<float>(target, size.x, size.y, img.mip_levels());
+    switch (target) {
+        case PixelStorage::BC1:
+            encode_mips<uint2>(_device, _bc1_shader, img, dst, cmd_buffer);
+            break;
+        case PixelStorage::BC3:
+            encode_mips<uint4>(_device, _bc3_shader, img, dst, cmd_buffer);
+            break;
+        case PixelStorage::BC4:
+            encode_mips<uint2>(_device, _bc4_shader, img, dst, cmd_buffer);
+            break;
+        case PixelStorage::BC5:
+            encode_mips<uint4>(_device, _bc5_shader, img, dst, cmd_buffer);
+            break;
+        case PixelStorage::BC6:
+            encode_mips<uint4>(_device, _bc6_shader, img, dst, cmd_buffer);
+            break;
+        case PixelStorage::BC7:
+            encode_mips<uint4>(_device, _bc7_shader, img, dst, cmd_buffer);
+            break;
+        default:
+            LUISA_ERROR("Compress target must be a block-compressed storage.");
+            break;
+    }
+    profile_device(cmd_buffer, "compress", begin, dst.byte_size());
+    return dst;
+}
+}// namespace luisa::compute
@@ -0,0 +1,18 @@
+#pragma once
+#include <runtime/device.h>
+#include <runtime/image.h>
+#include <runtime/buffer.h>
+#include <runtime/shader.h>
+#include <vstl/common.h>
+#include <filesystem>
+
+namespace luisa::compute::imglib_detail {
+// src_tex, output_blocks, src_size
+using BC8Shader = Shader2D<Image<float>, Buffer<uint2>, uint2>;
+using BC16Shader = Shader2D<Image<float>, Buffer<uint4>, uint2>;
+// BC1, BC4
+void compile_bc_shader(vstd::optional<BC8Shader> &shader, Device &device, PixelStorage storage, std::filesystem::path const &dir) noexcept;
+// BC3, BC5, BC6, BC7
+void compile_bc_shader(vstd::optional<BC16Shader> &shader, Device &device, PixelStorage storage, std::filesystem::path const &dir) noexcept;
+[[nodiscard]] bool is_block_compressed(PixelStorage storage) noexcept;
+}// namespace luisa::compute::imglib_detail
@@ -0,0 +1,183 @@
+#include <tools/image_lib.h>
+#include <dsl/syntax.h>
+#include <dsl/sugar.h>
+#include <core/logging.h>
+#include "exr_decode.h"
+#include "env_map.h"
+#include "shader_cache.h"
+#include <algorithm>
+
+namespace luisa::compute {
+namespace imglib_detail {
+// faces are stacked vertically in the order +X, -X, +Y, -Y, +Z, -Z, st in [-1, 1]^2
+static Float3 cube_face_dir(Expr<uint> face, Expr<float2> st) noexcept {
+    auto u = st.x;
+    auto v = st.y;
+    Float3 dir;
+    $switch(face) {
+        $case(0u) { dir = make_float3(1.0f, -v, -u); };
+        $case(1u) { dir = make_float3(-1.0f, -v, u); };
+        $case(2u) { dir = make_float3(u, 1.0f, v); };
+        $case(3u) { dir = make_float3(u, -1.0f, -v); };
+        $case(4u) { dir = make_float3(u, -v, 1.0f); };
+        $default { dir = make_float3(-u, -v, -1.0f); };
+    };
+    return normalize(dir);
+}
+// inverse of cube_face_dir, returns st in [-1, 1]^2
+static void cube_dir_to_face(Expr<float3> dir, UInt &face, Float2 &st) noexcept {
+    auto a = abs(dir);
+    $if((a.x >= a.y) && (a.x >= a.z)) {
+        face = select(1u, 0u, dir.x > 0.0f);
+        st = make_float2(select(dir.z, -dir.z, dir.x > 0.0f), -dir.y) / a.x;
+    }
+    $elif(a.y >= a.z) {
+        face = select(3u, 2u, dir.y > 0.0f);
+        st = make_float2(dir.x, select(-dir.z, dir.z, dir.y > 0.0f)) / a.y;
+    }
+    $else {
+        face = select(5u, 4u, dir.z > 0.0f);
+        st = make_float2(select(-dir.x, dir.x, dir.z > 0.0f), -dir.y) / a.z;
+    };
+}
+static void equirect_to_cube_kernel(BindlessVar heap, Float lod, UInt face_size, ImageVar<float> out_img) noexcept {
+    auto coord = dispatch_id().xy();
+    auto face = coord.y / face_size;
+    auto local = make_uint2(coord.x, coord.y % face_size);
+    auto st = (make_float2(local) + float2{0.5f}) / face_size.cast<float>() * 2.0f - 1.0f;
+    auto dir = cube_face_dir(face, st);
+    out_img.write(coord, heap.tex2d(0u).sample(DirToUv(dir), lod));
+}
+// prefilter of one texel of a stacked cube map, every sample direction picks its own face,
+// so the filter footprint crosses face edges; only the bilinear taps are clamped inside a face
+static void cube_prefilter_kernel(BindlessVar heap, BufferVar<float4> samples, UInt sample_count, UInt src_face_size, Float max_lod, ImageVar<float> out_img) noexcept {
+    auto coord = dispatch_id().xy();
+    auto face_size = dispatch_size().x;
+    auto face = coord.y / face_size;
+    auto local = make_uint2(coord.x, coord.y % face_size);
+    auto n = cube_face_dir(face, (make_float2(local) + float2{0.5f}) / face_size.cast<float>() * 2.0f - 1.0f);
+    auto up = select(select(float3{0, 1, 0}, float3{1, 0, 0}, abs(n.x) < 0.7f), float3{0, 0, 1}, abs(n.z) < 0.7f);
+    auto tangent_x = normalize(cross(up, n));
+    auto tangent_y = cross(n, tangent_x);
+    Float3 result = make_float3(0.0f);
+    Float weight = 0.0f;
+    for (auto i : range(sample_count)) {
+        auto s = samples.read(i);
+        auto l = normalize(tangent_x * s.x + tangent_y * s.y + n * s.z);
+        UInt sample_face;
+        Float2 st;
+        cube_dir_to_face(l, sample_face, st);
+        // cube texels shrink by (1 + u^2 + v^2)^(3/2) away from the face center
+        auto lod = clamp(s.w + 0.75f * log2(1.0f + dot(st, st)), 0.0f, max_lod);
+        // half texel of the coarser level read by the trilinear filter
+        auto level_size = max(src_face_size >> (lod.cast<uint>() + 1u), 1u).cast<float>();
+        auto border = 0.5f / level_size;
+        auto face_uv = clamp(st * 0.5f + 0.5f, border, 1.0f - border);
+        auto uv = make_float2(face_uv.x, (sample_face.cast<float>() + face_uv.y) / 6.0f);
+        auto color = heap.tex2d(0u).sample(uv, lod).xyz();
+        result += clamp(color, float3{0.0f}, float3{256.0f}) * s.z;
+        weight += s.z;
+    }
+    out_img.write(coord, make_float4(result / max(weight, 1e-4f), 1.0f));
+}
+static bool is_pow2(uint32_t x) noexcept {
+    return x != 0 && (x & (x - 1)) == 0;
+}
+}// namespace imglib_detail
+void ImageLib::init_cube_shaders() noexcept {
+    using namespace imglib_detail;
+    _equirect_to_cube_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{equirect_to_cube_kernel}, _path, "__equirect_to_cube");
+    };
+    _cube_prefilter_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{cube_prefilter_kernel}, _path, "__cube_prefilter");
+    };
+    add_warm_up(WARM_UP_CUBEMAP, "equirect_to_cube", _equirect_to_cube_shader);
+    add_warm_up(WARM_UP_CUBEMAP, "cube_prefilter", _cube_prefilter_shader);
+}
+Image<float> ImageLib::equirect_to_cube(Image<float> const &equirect, uint32_t face_size, uint32_t mip_level, CommandBuffer &cmd_buffer) noexcept {
+    if (mip_level == 0 || !imglib_detail::is_pow2(face_size) || (face_size >> (mip_level - 1)) == 0) {
+        LUISA_ERROR("Cube face size {} must be a power of two with at least {} mips.", face_size, mip_level);
+    }
+    auto begin = profile_now();
+    auto cube = _device.create_image<float>(PixelStorage::FLOAT4, face_size, face_size * 6, mip_level);
+    // a face spans a quarter of the lat-long width, pick the source mip of matching density
+    auto lod = std::clamp(std::log2(static_cast<float>(equirect.size().x) / (4.0f * face_size)), 0.0f, static_cast<float>(equirect.mip_levels() - 1));
+    auto heap = _device.create_bindless_array(1);
+    heap.emplace(0, equirect, Sampler::linear_linear_repeat());
+    cmd_buffer << heap.update()
+               << (*_equirect_to_cube_shader)(heap, lod, face_size, cube.view(0)).dispatch(cube.size())
+               << [heap = std::move(heap)] {};
+    profile_device(cmd_buffer, "equirect_to_cube", begin, cube.view(0).byte_size());
+    return cube;
+}
+void ImageLib::generate_cube_prefilter(Image<float> const &cube, CommandBuffer &cmd_buffer, float roughness, PrefilterOption option) noexcept {
+    auto mip_level = cube.mip_levels();
+    if (mip_level <= 1) {
+        return;
+    }
+    auto begin = profile_now();
+    auto face_size = cube.size().x;
+    // box-filtered source chain, 2x2 boxes never straddle faces of a power-of-two face size;
+    // same storage as cube, image copies do not convert
+    auto chain = _device.create_image<float>(cube.storage(), face_size, face_size * 6, mip_level);
+    cmd_buffer << chain.view(0).copy_from(cube.view(0));
+    generate_mip(chain, cmd_buffer);
+    auto heap = _device.create_bindless_array(1);
+    heap.emplace(0, chain, Sampler::linear_linear_edge());
+    cmd_buffer << heap.update();
+    auto filtered = option.mode == PrefilterMode::FILTERED;
+    auto sample_count = filtered ? option.sample_count : 65536u;
+    // solid angle of the face-centre texel, the per-sample lod correction is relative to it
+    auto texel_solid_angle = 4.0f / (static_cast<float>(face_size) * static_cast<float>(face_size));
+    luisa::vector<float4> samples;
+    luisa::vector<std::pair<size_t, size_t>> ranges;
+    for (auto &&i : vstd::range(1, mip_level)) {
+        auto rate = float(i) / (mip_level - 1);
+        auto rough = 1 * (1 - rate) + roughness * rate;
+        auto level_samples = imglib_detail::refl_fis_samples(sample_count, rough, texel_solid_angle);
+        if (!filtered) {
+            // point samples sit far below 0 so the per-texel lod corrections never lift them off mip 0
+            for (auto &&s : level_samples) {
+                s.w = -64.0f;
+            }
+        }
+        ranges.emplace_back(samples.size(), level_samples.size());
+        samples.insert(samples.end(), level_samples.begin(), level_samples.end());
+    }
+    auto sample_buffer = _device.create_buffer<float4>(samples.size());
+    cmd_buffer << sample_buffer.copy_from(samples.data());
+    // the chain only has mip_level levels, the border clamp must use the level that is sampled
+    auto max_lod = std::min(std::log2(static_cast<float>(face_size)), static_cast<float>(mip_level - 1));
+    for (auto &&i : vstd::range(1, mip_level)) {
+        auto dst_view = cube.view(i);
+        auto [offset, count] = ranges[i - 1];
+        cmd_buffer << (*_cube_prefilter_shader)(heap, sample_buffer.view(offset, count), static_cast<uint32_t>(count), face_size, max_lod, dst_view).dispatch(dst_view.size());
+    }
+    cmd_buffer << [chain = std::move(chain), heap = std::move(heap), sample_buffer = std::move(sample_buffer), samples = std::move(samples)] {};
+    profile_device(cmd_buffer, "generate_cube_prefilter", begin, cube.byte_size());
+}
+Image<float> ImageLib::read_exr_cube(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t face_size, uint32_t mip_level, float roughness, PrefilterOption option) noexcept {
+    luisa::unique_ptr<imglib_detail::DecodedExr> exr;
+    luisa::string error;
+    {
+        ProfileSpan span{this, "decode_exr"};
+        exr = imglib_detail::decode_exr(file_name, error);
+    }
+    if (exr == nullptr) {
+        LUISA_ERROR("{}", error);
+    }
+    // the full chain, so equirect_to_cube reads the level of matching density instead of aliasing mip 0
+    auto size = exr->size();
+    uint32_t source_mips = 1;
+    while ((std::max(size.x, size.y) >> source_mips) != 0) {
+        source_mips++;
+    }
+    auto equirect = upload_exr(*exr, file_name, cmd_buffer, source_mips, {}, {});
+    exr.reset();
+    auto cube = equirect_to_cube(equirect, face_size, mip_level, cmd_buffer);
+    cmd_buffer << [equirect = std::move(equirect)] {};
+    generate_cube_prefilter(cube, cmd_buffer, roughness, option);
+    return cube;
+}
+}// namespace luisa::compute
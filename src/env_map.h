@@ -0,0 +1,23 @@
+#pragma once
+#include <dsl/syntax.h>
+
+// lat-long mapping shared by the environment map kernels
+namespace luisa::compute::imglib_detail {
+constexpr float pi = 3.141592653589793f;
+inline Float2 DirToUv(Float3 w) noexcept {
+    Float theta = acos(w.y);
+    Float phi = atan2(w.x, w.z);
+    return fract(make_float2(1.f - 0.5f * inv_pi * phi, theta * inv_pi - 1.0f));
+}
+inline Float3 UvToDir(Float2 uv) noexcept {
+    uv.x = 1.0f - uv.x;
+    Float phi = 2.f * pi * uv.x;
+    Float theta = pi * uv.y;
+    Float sin_theta = sin(theta);
+    return normalize(make_float3(sin(phi) * sin_theta, cos(theta), cos(phi) * sin_theta));
+}
+// GGX samples as (L in tangent space with N = V, lod), L = reflect(-V, H). The lod is where the sample's
+// pdf footprint matches a source texel of texel_solid_angle (filtered importance sampling).
+// Roughness 0 gives the single mirror sample at lod 0.
+luisa::vector<float4> refl_fis_samples(uint32_t spp, float roughness, float texel_solid_angle) noexcept;
+}// namespace luisa::compute::imglib_detail
@@ -0,0 +1,30 @@
+#pragma once
+#include <core/basic_types.h>
+#include <vstl/common.h>
+#include <tinyexr.h>
+
+namespace luisa::compute::imglib_detail {
+// tinyexr's planar decode of a whole single-part EXR file, every channel in its stored
+// precision (half stays half), released on destruction
+struct DecodedExr {
+    EXRHeader header;
+    EXRImage image;
+    DecodedExr() noexcept {
+        InitEXRHeader(&header);
+        InitEXRImage(&image);
+    }
+    DecodedExr(DecodedExr const &) = delete;
+    DecodedExr &operator=(DecodedExr const &) = delete;
+    ~DecodedExr() noexcept {
+        FreeEXRImage(&image);
+        FreeEXRHeader(&header);
+    }
+    // the display window, the frame every EXR reader uses
+    [[nodiscard]] uint2 size() const noexcept {
+        return make_uint2(static_cast<uint32_t>(header.display_window.max_x - header.display_window.min_x + 1),
+                          static_cast<uint32_t>(header.display_window.max_y - header.display_window.min_y + 1));
+    }
+};
+// nullptr and the reason in error if the file can not be decoded
+[[nodiscard]] luisa::unique_ptr<DecodedExr> decode_exr(luisa::string const &file_name, luisa::string &error) noexcept;
+}// namespace luisa::compute::imglib_detail
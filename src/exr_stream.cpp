@@ -0,0 +1,326 @@
+#include <tools/image_lib.h>
+#include <dsl/syntax.h>
+#include <dsl/sugar.h>
+#include <core/logging.h>
+#include "exr_decode.h"
+#include "mapped_file.h"
+#include "shader_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace luisa::compute {
+namespace imglib_detail {
+// EXR pixel types in the strip kernel, 0 is a missing channel
+static constexpr uint32_t exr_type_missing = 0u;
+static constexpr uint32_t exr_type_half = 1u;
+static constexpr uint32_t exr_type_float = 2u;
+static constexpr uint32_t exr_type_uint = 3u;
+// raw rows of the planar channels tinyexr decodes, scanline or tiled (level 0), in data window coordinates
+class ExrPlanes {
+    EXRHeader const &_header;
+    EXRImage const &_image;
+    uint32_t _tiles_x{0};
+    luisa::vector<int32_t> _tile_index;
+
+public:
+    // channel of R, G, B, A, -1 if missing
+    int32_t rgba[4]{-1, -1, -1, -1};
+    ExrPlanes(EXRHeader const &header, EXRImage const &image) noexcept : _header(header), _image(image) {
+        for (auto c : vstd::range(header.num_channels)) {
+            luisa::string_view name{header.channels[c].name};
+            // layered names such as "diffuse.R"
+            if (auto dot = name.find_last_of('.'); dot != luisa::string_view::npos) {
+                name = name.substr(dot + 1);
+            }
+            constexpr char const *names[] = {"R", "G", "B", "A"};
+            for (auto i : vstd::range(4)) {
+                if (name == names[i]) {
+                    rgba[i] = static_cast<int32_t>(c);
+                }
+            }
+        }
+        // grayscale files replicate their first (luminance) channel like LoadEXR does
+        if (rgba[0] < 0 && rgba[1] < 0 && rgba[2] < 0) {
+            rgba[0] = rgba[1] = rgba[2] = 0;
+        }
+        if (header.tiled) {
+            _tiles_x = (image.width + header.tile_size_x - 1) / header.tile_size_x;
+            auto tiles_y = (image.height + header.tile_size_y - 1) / header.tile_size_y;
+            _tile_index.resize(_tiles_x * tiles_y, -1);
+            for (auto i : vstd::range(image.num_tiles)) {
+                auto &&tile = image.tiles[i];
+                if (tile.level_x == 0 && tile.level_y == 0) {
+                    _tile_index[tile.offset_y * _tiles_x + tile.offset_x] = static_cast<int32_t>(i);
+                }
+            }
+        }
+    }
+    // Channel read into each output slot. Four-channel storage takes R, G, B, A. With native_channels,
+    // one- and two-channel files keep their channels, in RGBA order then in file order, so a
+    // luminance-alpha file becomes (Y, A) like stb's grey-alpha; three channels are still padded to four.
+    [[nodiscard]] uint32_t slots(bool native_channels, int32_t (&slot)[4]) const noexcept {
+        auto count = native_channels ? std::clamp(_header.num_channels, 1, 4) : 4;
+        if (count >= 3) {
+            std::copy_n(rgba, 4, slot);
+            return 4u;
+        }
+        std::fill_n(slot, 4, -1);
+        int32_t filled = 0;
+        auto add = [&](int32_t channel) noexcept {
+            if (channel >= 0 && filled < count && std::find(slot, slot + filled, channel) == slot + filled) {
+                slot[filled++] = channel;
+            }
+        };
+        for (auto c : rgba) {
+            add(c);
+        }
+        for (auto c : vstd::range(_header.num_channels)) {
+            add(static_cast<int32_t>(c));
+        }
+        return static_cast<uint32_t>(count);
+    }
+    [[nodiscard]] uint32_t type(int32_t channel) const noexcept {
+        if (channel < 0) {
+            return exr_type_missing;
+        }
+        switch (_header.requested_pixel_types[channel]) {
+            case TINYEXR_PIXELTYPE_HALF: return exr_type_half;
+            case TINYEXR_PIXELTYPE_FLOAT: return exr_type_float;
+            default: return exr_type_uint;
+        }
+    }
+    [[nodiscard]] size_t element_size(int32_t channel) const noexcept {
+        return type(channel) == exr_type_half ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+    // texels [x0, x1) of row y of a channel, as stored
+    void copy_row(int32_t channel, uint32_t x0, uint32_t x1, uint32_t y, std::byte *dst) const noexcept {
+        auto size = element_size(channel);
+        if (!_header.tiled) {
+            memcpy(dst, _image.images[channel] + (static_cast<size_t>(y) * _image.width + x0) * size, (x1 - x0) * size);
+            return;
+        }
+        auto tile_y = y / _header.tile_size_y;
+        for (auto x = x0; x < x1;) {
+            auto tile_x = x / _header.tile_size_x;
+            auto end = std::min(x1, (tile_x + 1) * _header.tile_size_x);
+            auto tile = _tile_index[tile_y * _tiles_x + tile_x];
+            if (tile < 0) {
+                memset(dst, 0, (end - x) * size);
+            } else {
+                auto index = (y - tile_y * _header.tile_size_y) * _header.tile_size_x + (x - tile_x * _header.tile_size_x);
+                memcpy(dst, _image.tiles[tile].images[channel] + index * size, (end - x) * size);
+            }
+            dst += (end - x) * size;
+            x = end;
+        }
+    }
+};
+static Float half_to_float(Expr<uint> h) noexcept {
+    auto sign = (h & 0x8000u) << 16u;
+    auto exponent = (h >> 10u) & 0x1fu;
+    auto mantissa = h & 0x3ffu;
+    auto normal = (sign | ((exponent + 112u) << 23u) | (mantissa << 13u)).as<float>();
+    auto inf_nan = (sign | 0x7f800000u | (mantissa << 13u)).as<float>();
+    // denormals are mantissa * 2^-24
+    auto denormal = mantissa.cast<float>() * 5.9604644775390625e-8f;
+    return select(select(normal, inf_nan, exponent == 31u), select(denormal, -denormal, sign != 0u), exponent == 0u);
+}
+static Float exr_fetch(BufferVar<uint> const &raw, Expr<uint> offset, Expr<uint> type, Expr<uint> index) noexcept {
+    Float value = 0.0f;
+    $switch(type) {
+        $case(exr_type_half) {
+            // two halves per word, little-endian
+            auto word = raw.read(offset + index / 2u);
+            value = half_to_float((word >> ((index & 1u) * 16u)) & 0xffffu);
+        };
+        $case(exr_type_float) { value = raw.read(offset + index).as<float>(); };
+        $case(exr_type_uint) { value = raw.read(offset + index).cast<float>(); };
+        $default { value = 0.0f; };
+    };
+    return value;
+}
+// One output row per src_size.y / scale source rows. raw holds the source texels of the strip as
+// stored in the file, one plane per channel at offsets (in words), src_size.x texels per row;
+// texels outside valid (x0, y0, x1, y1) lie outside the data window and read as 0.
+static void exr_strip(BufferVar<uint> raw, UInt4 offsets, UInt4 types, UInt2 src_size, UInt4 valid, UInt scale, UInt row_offset, ImageVar<float> out_img) noexcept {
+    auto coord = dispatch_id().xy();
+    auto x0 = coord.x * scale;
+    auto y0 = coord.y * scale;
+    // the last row and column average a partial footprint
+    auto x1 = min(x0 + scale, src_size.x);
+    auto y1 = min(y0 + scale, src_size.y);
+    UInt offset[4] = {offsets.x, offsets.y, offsets.z, offsets.w};
+    UInt type[4] = {types.x, types.y, types.z, types.w};
+    Float4 sum = make_float4(0.0f);
+    for (auto dy : range(y1 - y0)) {
+        for (auto dx : range(x1 - x0)) {
+            auto sx = x0 + dx;
+            auto sy = y0 + dy;
+            $if(sx >= valid.x && sx < valid.z && sy >= valid.y && sy < valid.w) {
+                auto index = sy * src_size.x + sx;
+                Float v[4];
+                for (auto c : vstd::range(4)) {
+                    // missing color channels are 0, a missing alpha is opaque
+                    v[c] = select(exr_fetch(raw, offset[c], type[c], index), c == 3 ? 1.0f : 0.0f, type[c] == exr_type_missing);
+                }
+                sum += make_float4(v[0], v[1], v[2], v[3]);
+            };
+        }
+    }
+    out_img.write(make_uint2(coord.x, coord.y + row_offset), sum / ((x1 - x0) * (y1 - y0)).cast<float>());
+}
+luisa::unique_ptr<DecodedExr> decode_exr(luisa::string const &file_name, luisa::string &error) noexcept {
+    MappedFile file{std::filesystem::path{file_name.c_str()}};
+    if (!file.valid()) {
+        error = luisa::format("Can not open EXR file {}.", file_name);
+        return nullptr;
+    }
+    auto memory = reinterpret_cast<unsigned char const *>(file.bytes().data());
+    EXRVersion version;
+    if (ParseEXRVersionFromMemory(&version, memory, file.size()) != TINYEXR_SUCCESS || version.multipart) {
+        error = luisa::format("Unsupported EXR file {}.", file_name);
+        return nullptr;
+    }
+    auto exr = luisa::make_unique<DecodedExr>();
+    char const *err = nullptr;
+    // tinyexr decodes whole images only; half channels stay half
+    if (ParseEXRHeaderFromMemory(&exr->header, &version, memory, file.size(), &err) != TINYEXR_SUCCESS ||
+        LoadEXRImageFromMemory(&exr->image, &exr->header, memory, file.size(), &err) != TINYEXR_SUCCESS) {
+        error = luisa::format("Load EXR {} error: {}", file_name, err != nullptr ? err : "unknown");
+        FreeEXRErrorMessage(err);
+        return nullptr;
+    }
+    if (exr->header.display_window.max_x < exr->header.display_window.min_x ||
+        exr->header.display_window.max_y < exr->header.display_window.min_y) {
+        error = luisa::format("Empty display window in EXR file {}.", file_name);
+        return nullptr;
+    }
+    return exr;
+}
+}// namespace imglib_detail
+void ImageLib::init_exr_shaders() noexcept {
+    using namespace imglib_detail;
+    _exr_strip_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{exr_strip}, _path, "__exr_strip");
+    };
+    add_warm_up(WARM_UP_READ, "exr_strip", _exr_strip_shader);
+}
+Image<float> ImageLib::read_exr_region(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ExrRegion region, ReadOption option) noexcept {
+    luisa::unique_ptr<imglib_detail::DecodedExr> exr;
+    luisa::string error;
+    {
+        ProfileSpan span{this, "decode_exr"};
+        exr = imglib_detail::decode_exr(file_name, error);
+    }
+    if (exr == nullptr) {
+        LUISA_ERROR("{}", error);
+    }
+    return upload_exr(*exr, file_name, cmd_buffer, mip_level, region, option);
+}
+Image<float> ImageLib::upload_exr(imglib_detail::DecodedExr const &exr, luisa::string_view file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ExrRegion region, ReadOption option) noexcept {
+    using namespace imglib_detail;
+    auto &&header = exr.header;
+    auto &&image = exr.image;
+    // the region is in display window coordinates, the pixels cover the data window
+    auto display = header.display_window;
+    auto data = header.data_window;
+    auto width = exr.size().x;
+    auto height = exr.size().y;
+    auto data_x0 = static_cast<int64_t>(data.min_x) - display.min_x;
+    auto data_y0 = static_cast<int64_t>(data.min_y) - display.min_y;
+    auto data_x1 = data_x0 + image.width;
+    auto data_y1 = data_y0 + image.height;
+    auto roi_offset = min(region.offset, make_uint2(width, height));
+    auto roi_size = region.size;
+    if (roi_size.x == 0) roi_size.x = width - roi_offset.x;
+    if (roi_size.y == 0) roi_size.y = height - roi_offset.y;
+    roi_size = min(roi_size, make_uint2(width, height) - roi_offset);
+    if (roi_size.x == 0 || roi_size.y == 0) {
+        LUISA_ERROR("Empty region of EXR file {} ({}x{}).", file_name, width, height);
+    }
+    auto scale = 1u << region.downsample;
+    auto out_size = (roi_size + make_uint2(scale - 1u)) / scale;
+    ExrPlanes planes{header, image};
+    int32_t slot[4];
+    auto channels = planes.slots(option.native_channels, slot);
+    auto storage = channels == 1 ? (option.half ? PixelStorage::HALF1 : PixelStorage::FLOAT1) :
+                   channels == 2 ? (option.half ? PixelStorage::HALF2 : PixelStorage::FLOAT2) :
+                                   (option.half ? PixelStorage::HALF4 : PixelStorage::FLOAT4);
+    auto img = _device.create_image<float>(storage, out_size.x, out_size.y, mip_level);
+    // one plane per distinct channel, a grayscale file uploads its channel once
+    auto strip_rows = std::clamp(region.strip_rows, 1u, out_size.y);
+    auto max_src_rows = std::min(strip_rows * scale, roi_size.y);
+    int32_t plane_channels[4];
+    uint32_t plane_of[4];
+    uint32_t plane_count = 0;
+    for (auto i : vstd::range(4)) {
+        auto channel = slot[i];
+        plane_of[i] = plane_count;
+        if (channel < 0) {
+            continue;
+        }
+        auto same = std::find(plane_channels, plane_channels + plane_count, channel);
+        plane_of[i] = static_cast<uint32_t>(same - plane_channels);
+        if (same == plane_channels + plane_count) {
+            plane_channels[plane_count++] = channel;
+        }
+    }
+    auto plane_words = [&](uint32_t plane, uint32_t rows) noexcept {
+        return (static_cast<size_t>(roi_size.x) * rows * planes.element_size(plane_channels[plane]) + sizeof(uint) - 1) / sizeof(uint);
+    };
+    size_t strip_words = 0;
+    for (auto p : vstd::range(plane_count)) {
+        strip_words += plane_words(p, max_src_rows);
+    }
+    strip_words = std::max<size_t>(strip_words, 1u);
+    // the host fills up to four staging strips ahead of the device; the single device buffer is
+    // reused, so on the device each strip is converted before the next one is copied in
+    auto pool = luisa::make_shared<StagingPool>(strip_words * sizeof(uint) * 4, strip_words * sizeof(uint));
+    auto raw_buffer = _device.create_buffer<uint>(strip_words);
+    auto types = make_uint4(planes.type(slot[0]), planes.type(slot[1]), planes.type(slot[2]), planes.type(slot[3]));
+    auto upload_begin = profile_now();
+    for (uint32_t row = 0; row < out_size.y; row += strip_rows) {
+        auto rows = std::min(strip_rows, out_size.y - row);
+        auto src_y0 = roi_offset.y + row * scale;
+        auto src_rows = std::min(rows * scale, roi_offset.y + roi_size.y - src_y0);
+        // the part of the strip covered by the data window, strip-local
+        auto clamp_to = [](int64_t v, uint32_t hi) noexcept { return static_cast<uint32_t>(std::clamp<int64_t>(v, 0, hi)); };
+        auto valid = make_uint4(
+            clamp_to(data_x0 - roi_offset.x, roi_size.x), clamp_to(data_y0 - src_y0, src_rows),
+            clamp_to(data_x1 - roi_offset.x, roi_size.x), clamp_to(data_y1 - src_y0, src_rows));
+        uint32_t plane_offsets[4] = {};
+        size_t words = 0;
+        for (auto p : vstd::range(plane_count)) {
+            plane_offsets[p] = static_cast<uint32_t>(words);
+            words += plane_words(p, src_rows);
+        }
+        words = std::max<size_t>(words, 1u);
+        auto chunk = acquire_staging(*pool, words * sizeof(uint), cmd_buffer);
+        {
+            ProfileSpan span{this, "copy_strip", words * sizeof(uint)};
+            if (valid.x < valid.z) {
+                for (auto p : vstd::range(plane_count)) {
+                    auto channel = plane_channels[p];
+                    auto size = planes.element_size(channel);
+                    auto dst = chunk.data() + plane_offsets[p] * sizeof(uint);
+                    auto plane_x0 = static_cast<uint32_t>(roi_offset.x + valid.x - data_x0);
+                    for (auto y = valid.y; y < valid.w; ++y) {
+                        auto plane_y = static_cast<uint32_t>(src_y0 + y - data_y0);
+                        planes.copy_row(channel, plane_x0, plane_x0 + (valid.z - valid.x), plane_y, dst + (static_cast<size_t>(y) * roi_size.x + valid.x) * size);
+                    }
+                }
+            }
+        }
+        auto offsets = make_uint4(plane_offsets[plane_of[0]], plane_offsets[plane_of[1]], plane_offsets[plane_of[2]], plane_offsets[plane_of[3]]);
+        cmd_buffer << raw_buffer.view(0, words).copy_from(chunk.data())
+                   << (*_exr_strip_shader)(raw_buffer, offsets, types, make_uint2(roi_size.x, src_rows), valid, scale, row, img.view(0)).dispatch(out_size.x, rows)
+                   << [pool, chunk = std::move(chunk)]() mutable { pool->release(std::move(chunk)); };
+    }
+    cmd_buffer << [raw_buffer = std::move(raw_buffer)] {};
+    profile_device(cmd_buffer, "upload", upload_begin, img.view(0).byte_size());
+    if (mip_level > 1) {
+        generate_mip(img, cmd_buffer);
+    }
+    return img;
+}
+}// namespace luisa::compute
@@ -0,0 +1,61 @@
+#include <stb/stb_image.h>
+#include <core/logging.h>
+#include "image_decode.h"
+#include <cctype>
+#include <filesystem>
+
+namespace luisa::compute::imglib_detail {
+DecodedImage decode_ldr(luisa::string const &file_name, luisa::string &error, bool native_channels) noexcept {
+    int32_t x, y, channel = 4;
+    if (native_channels && !stbi_info(file_name.c_str(), &x, &y, &channel)) {
+        error = luisa::format("Load image {} error: {}", file_name, stbi_failure_reason());
+        return {};
+    }
+    // there is no three-channel storage
+    auto desired = channel == 3 ? 4 : channel;
+    auto ptr = stbi_load(file_name.c_str(), &x, &y, &channel, desired);
+    if (ptr == nullptr) {
+        error = luisa::format("Load image {} error: {}", file_name, stbi_failure_reason());
+        return {};
+    }
+    return DecodedImage{
+        .data = ptr,
+        .deleter = [](void *ptr) { stbi_image_free(ptr); },
+        .width = static_cast<uint32_t>(x),
+        .height = static_cast<uint32_t>(y),
+        .storage = desired == 1 ? PixelStorage::BYTE1 : (desired == 2 ? PixelStorage::BYTE2 : PixelStorage::BYTE4),
+        .channels = static_cast<uint32_t>(channel)};
+}
+DecodedImage decode_hdr(luisa::string const &file_name, luisa::string &error) noexcept {
+    int32_t x, y, channel;
+    auto ptr = stbi_loadf(file_name.c_str(), &x, &y, &channel, 4);
+    if (ptr == nullptr) {
+        error = luisa::format("Load image {} error: {}", file_name, stbi_failure_reason());
+        return {};
+    }
+    return DecodedImage{
+        .data = ptr,
+        .deleter = [](void *ptr) { stbi_image_free(ptr); },
+        .width = static_cast<uint32_t>(x),
+        .height = static_cast<uint32_t>(y),
+        .storage = PixelStorage::FLOAT4,
+        .channels = static_cast<uint32_t>(channel)};
+}
+static std::string lower_extension(luisa::string const &file_name) noexcept {
+    auto ext = std::filesystem::path{file_name.c_str()}.extension().string();
+    for (auto &&c : ext) {
+        c = static_cast<char>(std::tolower(c));
+    }
+    return ext;
+}
+bool is_exr_file(luisa::string const &file_name) noexcept {
+    return lower_extension(file_name) == ".exr";
+}
+DecodedImage decode_file(luisa::string const &file_name, luisa::string &error, bool native_channels) noexcept {
+    auto ext = lower_extension(file_name);
+    if (ext == ".hdr") {
+        return decode_hdr(file_name, error);
+    }
+    return decode_ldr(file_name, error, native_channels);
+}
+}// namespace luisa::compute::imglib_detail
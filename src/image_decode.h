@@ -0,0 +1,24 @@
+#pragma once
+#include <runtime/pixel.h>
+#include <vstl/common.h>
+
+namespace luisa::compute::imglib_detail {
+// Host pixels produced by stb or tinyexr, owned until passed to ImageLib::upload_decoded
+struct DecodedImage {
+    void *data{nullptr};
+    void (*deleter)(void *){nullptr};
+    uint32_t width{0};
+    uint32_t height{0};
+    PixelStorage storage{PixelStorage::BYTE4};
+    // channel count of the source file, may be less than the channels of storage
+    uint32_t channels{4};
+};
+// data is nullptr and the reason in error if the file can not be decoded;
+// with native_channels, one- and two-channel files decode to BYTE1 / BYTE2
+[[nodiscard]] DecodedImage decode_ldr(luisa::string const &file_name, luisa::string &error, bool native_channels = false) noexcept;
+[[nodiscard]] DecodedImage decode_hdr(luisa::string const &file_name, luisa::string &error) noexcept;
+// EXR files are decoded into planes by decode_exr (exr_decode.h) and uploaded by ImageLib::upload_exr
+[[nodiscard]] bool is_exr_file(luisa::string const &file_name) noexcept;
+// an LDR or HDR file, the decoder is chosen by the file extension
+[[nodiscard]] DecodedImage decode_file(luisa::string const &file_name, luisa::string &error, bool native_channels = false) noexcept;
+}// namespace luisa::compute::imglib_detail
@@ -1,159 +1,492 @@
 #include <tools/image_lib.h>
 #include <core/binary_io_visitor.h>
-#include <stb/stb_image.h>
 #include <dsl/syntax.h>
 #include <dsl/sugar.h>
-#include <tinyexr.h>
 #include <core/logging.h>
+#include <core/clock.h>
+#include "mapped_file.h"
+#include "block_compress.h"
+#include "image_decode.h"
+#include "env_map.h"
+#include "shader_cache.h"
+#include "profiler.h"
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 namespace luisa::compute {
-size_t img_byte_size(PixelStorage storage, uint32_t width, uint32_t height, uint32_t volume, uint32_t mip_level) noexcept {
-    size_t size = 0;
-    for (auto i : vstd::range(mip_level)) {
-        size += pixel_storage_size(storage, width, height, volume);
-        width /= 2;
-        height /= 2;
-    }
-    return size;
-}
-
 namespace imglib_detail {
+// v1 layout: raw header followed by mip 0..n-1
 struct ImageHeader {
     uint32_t width, height, mip_level, volume;
     PixelStorage storage;
 };
-template<typename T>
-Image<T> load_image_impl(IBinaryStream *bin_stream, Device &device, CommandBuffer &cmd_buffer) noexcept {
-    ImageHeader header;
-    bin_stream->read({reinterpret_cast<std::byte *>(&header), sizeof(ImageHeader)});
-    auto byte_size = img_byte_size(header.storage, header.width, header.height, 1, header.mip_level);
-    vstd::vector<std::byte> data;
-    data.push_back_uninitialized(byte_size);
-    bin_stream->read(data);
-    auto img = device.create_image<T>(header.storage, header.width, header.height, header.mip_level);
-    auto ptr = data.data();
+// v2 layout: header, mip table, then mips from the coarsest to the finest,
+// so low LODs can be read from the front of the file
+static constexpr uint32_t image_magic = 0x4d49434cu;// "LCIM"
+static constexpr uint32_t image_version = 2u;
+static constexpr uint32_t image_flag_checksum = 1u;
+// checksums are chained over checksum_block_size blocks, so a mip can be hashed strip by strip
+static constexpr uint32_t image_flag_block_checksum = 2u;
+static constexpr size_t checksum_block_size = 1ull << 20u;
+struct ImageHeaderV2 {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height, volume, mip_level;
+    PixelStorage storage;
+    uint32_t flags;
+};
+struct MipEntry {
+    // offset from the beginning of the file
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+struct ParsedHeader {
+    ImageHeaderV2 header;
+    luisa::vector<MipEntry> mips;
+};
+static size_t mip_byte_size(PixelStorage storage, uint32_t width, uint32_t height, uint32_t volume, uint32_t level) noexcept {
+    return pixel_storage_size(
+        storage,
+        std::max(width >> level, 1u),
+        std::max(height >> level, 1u),
+        std::max(volume >> level, 1u));
+}
+// every call but the last of a mip must cover a whole number of blocks
+static uint64_t block_checksum(uint64_t seed, std::byte const *ptr, size_t size) noexcept {
+    while (size > 0) {
+        auto block = std::min(size, checksum_block_size);
+        seed = luisa::hash64(ptr, block, seed);
+        ptr += block;
+        size -= block;
+    }
+    return seed;
+}
+static uint64_t mip_checksum(std::byte const *ptr, size_t size, uint32_t flags) noexcept {
+    if ((flags & image_flag_block_checksum) != 0) {
+        return block_checksum(image_magic, ptr, size);
+    }
+    return luisa::hash64(ptr, size, image_magic);
+}
+// the reason in error if the bytes do not hold a whole header
+static ParsedHeader parse_header(std::byte const *ptr, size_t size, bool is_volume, luisa::string &error) noexcept {
+    ParsedHeader result;
+    auto &header = result.header;
+    uint32_t magic;
+    if (size < sizeof(ImageHeader)) {
+        error = "Image data is truncated.";
+        return result;
+    }
+    memcpy(&magic, ptr, sizeof(uint32_t));
+    if (magic == image_magic) {
+        if (size < sizeof(ImageHeaderV2)) {
+            error = "Image data is truncated.";
+            return result;
+        }
+        memcpy(&header, ptr, sizeof(ImageHeaderV2));
+        if (header.version > image_version) {
+            error = luisa::format("Unsupported image version {}.", header.version);
+            return result;
+        }
+        auto table_size = sizeof(MipEntry) * header.mip_level;
+        if (size < sizeof(ImageHeaderV2) + table_size) {
+            error = "Image data is truncated.";
+            return result;
+        }
+        result.mips.push_back_uninitialized(header.mip_level);
+        memcpy(result.mips.data(), ptr + sizeof(ImageHeaderV2), table_size);
+        return result;
+    }
+    ImageHeader v1;
+    memcpy(&v1, ptr, sizeof(ImageHeader));
+    header = ImageHeaderV2{
+        .magic = image_magic,
+        .version = 1,
+        .width = v1.width,
+        .height = v1.height,
+        .volume = is_volume ? v1.volume : 1,
+        .mip_level = v1.mip_level,
+        .storage = v1.storage,
+        .flags = 0};
+    uint64_t offset = sizeof(ImageHeader);
+    result.mips.reserve(header.mip_level);
     for (auto i : vstd::range(header.mip_level)) {
-        auto view = img.view(i);
-        cmd_buffer << view.copy_from(ptr);
-        ptr += view.byte_size();
+        auto mip_size = mip_byte_size(header.storage, header.width, header.height, header.volume, i);
+        result.mips.push_back(MipEntry{.offset = offset, .size = mip_size, .checksum = 0});
+        offset += mip_size;
+    }
+    return result;
+}
+static ParsedHeader parse_header(std::byte const *ptr, size_t size, bool is_volume) noexcept {
+    luisa::string error;
+    auto result = parse_header(ptr, size, is_volume, error);
+    if (!error.empty()) {
+        LUISA_ERROR("{}", error);
+    }
+    return result;
+}
+static ParsedHeader read_header(IBinaryStream *bin_stream, bool is_volume, size_t &stream_pos) noexcept {
+    std::byte header_bytes[std::max(sizeof(ImageHeader), sizeof(ImageHeaderV2))];
+    bin_stream->read({header_bytes, sizeof(ImageHeader)});
+    stream_pos = sizeof(ImageHeader);
+    uint32_t magic;
+    memcpy(&magic, header_bytes, sizeof(uint32_t));
+    if (magic != image_magic) {
+        return parse_header(header_bytes, sizeof(ImageHeader), is_volume);
+    }
+    bin_stream->read({header_bytes + sizeof(ImageHeader), sizeof(ImageHeaderV2) - sizeof(ImageHeader)});
+    ImageHeaderV2 header;
+    memcpy(&header, header_bytes, sizeof(ImageHeaderV2));
+    luisa::vector<std::byte> bytes;
+    bytes.push_back_uninitialized(sizeof(ImageHeaderV2) + sizeof(MipEntry) * header.mip_level);
+    memcpy(bytes.data(), header_bytes, sizeof(ImageHeaderV2));
+    bin_stream->read({bytes.data() + sizeof(ImageHeaderV2), bytes.size() - sizeof(ImageHeaderV2)});
+    stream_pos = bytes.size();
+    return parse_header(bytes.data(), bytes.size(), is_volume);
+}
+static void skip_bytes(IBinaryStream *bin_stream, size_t size) noexcept {
+    std::byte scratch[4096];
+    while (size > 0) {
+        auto chunk = std::min(size, sizeof(scratch));
+        bin_stream->read({scratch, chunk});
+        size -= chunk;
+    }
+}
+// clamp the requested range and return the byte range it covers in the file
+static std::pair<uint64_t, uint64_t> select_mips(ParsedHeader const &parsed, ImageLib::MipRange &range) noexcept {
+    range.end = std::min(range.end, parsed.header.mip_level);
+    if (range.begin >= range.end) {
+        LUISA_ERROR("Invalid mip range [{}, {}) for image with {} mips.", range.begin, range.end, parsed.header.mip_level);
+    }
+    auto begin = std::numeric_limits<uint64_t>::max();
+    uint64_t end = 0;
+    for (auto i : vstd::range(range.begin, range.end)) {
+        auto &&mip = parsed.mips[i];
+        begin = std::min(begin, mip.offset);
+        end = std::max(end, mip.offset + mip.size);
+    }
+    return {begin, end};
+}
+// data points to the byte at file offset "data_offset"; every mip is checked before the first copy,
+// so nothing is queued from data that is rejected
+template<typename Img>
+static bool upload_mips(Img &img, ParsedHeader const &parsed, ImageLib::MipRange range, std::byte const *data, uint64_t data_offset, CommandBuffer &cmd_buffer, luisa::string &error) noexcept {
+    for (auto i : vstd::range(range.begin, range.end)) {
+        auto &&mip = parsed.mips[i];
+        auto view = img.view(i - range.begin);
+        if (view.byte_size() != mip.size) {
+            error = luisa::format("Mip {} size mismatch: expected {}, got {}.", i, view.byte_size(), mip.size);
+            return false;
+        }
+        if ((parsed.header.flags & image_flag_checksum) != 0 && mip_checksum(data + (mip.offset - data_offset), mip.size, parsed.header.flags) != mip.checksum) {
+            error = luisa::format("Mip {} checksum mismatch.", i);
+            return false;
+        }
+    }
+    for (auto i : vstd::range(range.begin, range.end)) {
+        cmd_buffer << img.view(i - range.begin).copy_from(data + (parsed.mips[i].offset - data_offset));
+    }
+    return true;
+}
+template<typename Img>
+static void upload_mips(Img &img, ParsedHeader const &parsed, ImageLib::MipRange range, std::byte const *data, uint64_t data_offset, CommandBuffer &cmd_buffer) noexcept {
+    luisa::string error;
+    if (!upload_mips(img, parsed, range, data, data_offset, cmd_buffer, error)) {
+        LUISA_ERROR("{}", error);
+    }
+}
+template<typename T, bool is_volume>
+static auto create_mips(Device &device, ImageHeaderV2 const &header, ImageLib::MipRange range) noexcept {
+    auto width = std::max(header.width >> range.begin, 1u);
+    auto height = std::max(header.height >> range.begin, 1u);
+    auto mip_level = range.end - range.begin;
+    if constexpr (is_volume) {
+        auto volume = std::max(header.volume >> range.begin, 1u);
+        return device.create_volume<T>(header.storage, width, height, volume, mip_level);
+    } else {
+        return device.create_image<T>(header.storage, width, height, mip_level);
     }
-    cmd_buffer << [data = std::move(data)] {};
-    return img;
 }
-template<typename T>
-Volume<T> load_volume_impl(IBinaryStream *bin_stream, Device &device, CommandBuffer &cmd_buffer) noexcept {
-    ImageHeader header;
-    bin_stream->read({reinterpret_cast<std::byte *>(&header), sizeof(ImageHeader)});
-    auto byte_size = img_byte_size(header.storage, header.width, header.height, header.volume, header.mip_level);
+template<typename T, bool is_volume>
+static auto load_impl(IBinaryStream *bin_stream, Device &device, CommandBuffer &cmd_buffer, ImageLib::MipRange range) noexcept {
+    size_t stream_pos;
+    auto parsed = read_header(bin_stream, is_volume, stream_pos);
+    auto [begin, end] = select_mips(parsed, range);
+    if (begin < stream_pos) {
+        LUISA_ERROR("Mip table points into the header.");
+    }
+    // the stream is sequential, bytes before the requested mips are skipped
+    skip_bytes(bin_stream, begin - stream_pos);
     vstd::vector<std::byte> data;
-    data.push_back_uninitialized(byte_size);
+    data.push_back_uninitialized(end - begin);
     bin_stream->read(data);
-    auto img = device.create_volume<T>(header.storage, header.width, header.height, header.mip_level);
-    auto ptr = data.data();
-    for (auto i : vstd::range(header.mip_level)) {
-        auto view = img.view(i);
-        cmd_buffer << view.copy_from(ptr);
-        ptr += view.byte_size();
-    }
+    auto img = create_mips<T, is_volume>(device, parsed.header, range);
+    upload_mips(img, parsed, range, data.data(), begin, cmd_buffer);
     cmd_buffer << [data = std::move(data)] {};
     return img;
 }
-
+// an empty texture and the reason in error if the mapping is truncated or corrupt
+template<typename T, bool is_volume>
+static auto load_impl(MappedFile &&file, Device &device, CommandBuffer &cmd_buffer, ImageLib::MipRange range, luisa::string &error) noexcept {
+    using Tex = std::conditional_t<is_volume, Volume<T>, Image<T>>;
+    auto bytes = file.bytes();
+    auto parsed = parse_header(bytes.data(), bytes.size(), is_volume, error);
+    if (!error.empty()) {
+        return Tex{};
+    }
+    auto [begin, end] = select_mips(parsed, range);
+    if (bytes.size() < end) {
+        error = "Image data is truncated.";
+        return Tex{};
+    }
+    // only the pages of the requested mips are touched
+    Tex img = create_mips<T, is_volume>(device, parsed.header, range);
+    if (!upload_mips(img, parsed, range, bytes.data(), 0, cmd_buffer, error)) {
+        return Tex{};
+    }
+    cmd_buffer << [file = std::move(file)] {};
+    return img;
+}
+template<typename T, bool is_volume>
+static auto load_impl(std::filesystem::path const &path, Device &device, CommandBuffer &cmd_buffer, ImageLib::MipRange range) noexcept {
+    MappedFile file{path};
+    if (!file.valid()) {
+        LUISA_ERROR("Map image file {} failed.", path.string());
+    }
+    luisa::string error;
+    auto img = load_impl<T, is_volume>(std::move(file), device, cmd_buffer, range, error);
+    if (!error.empty()) {
+        LUISA_ERROR("Load image file {} failed: {}", path.string(), error);
+    }
+    return img;
+}
 }// namespace imglib_detail
-Image<float> ImageLib::load_float_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
-    return imglib_detail::load_image_impl<float>(bin_stream, _device, cmd_buffer);
+template<typename Tex, typename Load>
+Tex ImageLib::profile_load(luisa::string_view name, CommandBuffer &cmd_buffer, Load &&load) noexcept {
+    auto begin = profile_now();
+    ProfileSpan span{this, name};
+    auto tex = load();
+    span.bytes = tex.byte_size();
+    if (begin >= 0) {
+        profile_device(cmd_buffer, luisa::format("{}.upload", name), begin, tex.byte_size());
+    }
+    return tex;
 }
-Image<int32_t> ImageLib::load_int_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
-    return imglib_detail::load_image_impl<int32_t>(bin_stream, _device, cmd_buffer);
+Image<float> ImageLib::load_float_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Image<float>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<float, false>(bin_stream, _device, cmd_buffer, range); });
 }
-Image<uint32_t> ImageLib::load_uint_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
-    return imglib_detail::load_image_impl<uint32_t>(bin_stream, _device, cmd_buffer);
+Image<int32_t> ImageLib::load_int_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Image<int32_t>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<int32_t, false>(bin_stream, _device, cmd_buffer, range); });
 }
-Volume<float> ImageLib::load_float_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
-    return imglib_detail::load_volume_impl<float>(bin_stream, _device, cmd_buffer);
+Image<uint32_t> ImageLib::load_uint_image(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Image<uint32_t>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<uint32_t, false>(bin_stream, _device, cmd_buffer, range); });
 }
-Volume<int32_t> ImageLib::load_int_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
-    return imglib_detail::load_volume_impl<int32_t>(bin_stream, _device, cmd_buffer);
+Volume<float> ImageLib::load_float_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Volume<float>>("load_volume", cmd_buffer, [&] { return imglib_detail::load_impl<float, true>(bin_stream, _device, cmd_buffer, range); });
 }
-Volume<uint32_t> ImageLib::load_uint_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer) noexcept {
-    return imglib_detail::load_volume_impl<uint32_t>(bin_stream, _device, cmd_buffer);
+Volume<int32_t> ImageLib::load_int_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Volume<int32_t>>("load_volume", cmd_buffer, [&] { return imglib_detail::load_impl<int32_t, true>(bin_stream, _device, cmd_buffer, range); });
 }
-size_t ImageLib::header_size() noexcept {
-    return sizeof(imglib_detail::ImageHeader);
+Volume<uint32_t> ImageLib::load_uint_volume(IBinaryStream *bin_stream, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Volume<uint32_t>>("load_volume", cmd_buffer, [&] { return imglib_detail::load_impl<uint32_t, true>(bin_stream, _device, cmd_buffer, range); });
 }
-void ImageLib::save_header(
+Image<float> ImageLib::load_float_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Image<float>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<float, false>(path, _device, cmd_buffer, range); });
+}
+Image<int32_t> ImageLib::load_int_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Image<int32_t>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<int32_t, false>(path, _device, cmd_buffer, range); });
+}
+Image<uint32_t> ImageLib::load_uint_image(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Image<uint32_t>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<uint32_t, false>(path, _device, cmd_buffer, range); });
+}
+Image<float> ImageLib::load_float_image(MappedFile &&file, CommandBuffer &cmd_buffer, MipRange range, luisa::string &error) noexcept {
+    return profile_load<Image<float>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<float, false>(std::move(file), _device, cmd_buffer, range, error); });
+}
+Image<int32_t> ImageLib::load_int_image(MappedFile &&file, CommandBuffer &cmd_buffer, MipRange range, luisa::string &error) noexcept {
+    return profile_load<Image<int32_t>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<int32_t, false>(std::move(file), _device, cmd_buffer, range, error); });
+}
+Image<uint32_t> ImageLib::load_uint_image(MappedFile &&file, CommandBuffer &cmd_buffer, MipRange range, luisa::string &error) noexcept {
+    return profile_load<Image<uint32_t>>("load_image", cmd_buffer, [&] { return imglib_detail::load_impl<uint32_t, false>(std::move(file), _device, cmd_buffer, range, error); });
+}
+Volume<float> ImageLib::load_float_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Volume<float>>("load_volume", cmd_buffer, [&] { return imglib_detail::load_impl<float, true>(path, _device, cmd_buffer, range); });
+}
+Volume<int32_t> ImageLib::load_int_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Volume<int32_t>>("load_volume", cmd_buffer, [&] { return imglib_detail::load_impl<int32_t, true>(path, _device, cmd_buffer, range); });
+}
+Volume<uint32_t> ImageLib::load_uint_volume(std::filesystem::path const &path, CommandBuffer &cmd_buffer, MipRange range) noexcept {
+    return profile_load<Volume<uint32_t>>("load_volume", cmd_buffer, [&] { return imglib_detail::load_impl<uint32_t, true>(path, _device, cmd_buffer, range); });
+}
+ImageLib::ImageInfo ImageLib::read_image_info(std::filesystem::path const &path) noexcept {
+    MappedFile file{path};
+    if (!file.valid()) {
+        LUISA_ERROR("Map image file {} failed.", path.string());
+    }
+    auto bytes = file.bytes();
+    auto parsed = imglib_detail::parse_header(bytes.data(), bytes.size(), false);
+    auto &&header = parsed.header;
+    return ImageInfo{
+        .size = make_uint3(header.width, header.height, header.volume),
+        .mip_level = header.mip_level,
+        .storage = header.storage};
+}
+size_t ImageLib::header_size(uint32_t mip) noexcept {
+    return sizeof(imglib_detail::ImageHeaderV2) + sizeof(imglib_detail::MipEntry) * mip;
+}
+void ImageLib::write_header(
     luisa::span<std::byte> data,
     uint32_t width, uint32_t height, uint32_t volume,
     PixelStorage storage,
-    uint32_t mip) noexcept {
-    imglib_detail::ImageHeader header{
+    uint32_t mip,
+    luisa::span<uint64_t const> checksums) noexcept {
+    using namespace imglib_detail;
+    ImageHeaderV2 header{
+        .magic = image_magic,
+        .version = image_version,
         .width = width,
         .height = height,
-        .mip_level = mip,
         .volume = volume,
-        .storage = storage};
-    memcpy(data.data(), &header, sizeof(imglib_detail::ImageHeader));
-}
-Image<float> ImageLib::read_ldr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level) noexcept {
-    int32_t x, y, channel;
-    auto ptr = stbi_load(file_name.c_str(), &x, &y, &channel, 4);
-    auto img = _device.create_image<float>(PixelStorage::BYTE4, x, y, mip_level);
-    cmd_buffer << img.copy_from(ptr) << [ptr] {
-        stbi_image_free(ptr);
-    };
-    if (mip_level > 1) {
-        generate_mip(img, cmd_buffer);
+        .mip_level = mip,
+        .storage = storage,
+        .flags = checksums.empty() ? 0u : (image_flag_checksum | image_flag_block_checksum)};
+    memcpy(data.data(), &header, sizeof(ImageHeaderV2));
+    luisa::vector<MipEntry> mips;
+    mips.push_back_uninitialized(mip);
+    uint64_t offset = header_size(mip);
+    for (auto i : vstd::range(mip)) {
+        auto level = mip - 1 - i;
+        auto &&entry = mips[level];
+        entry.offset = offset;
+        entry.size = mip_byte_size(storage, width, height, volume, level);
+        entry.checksum = checksums.empty() ? 0 : checksums[level];
+        offset += entry.size;
     }
-    return img;
+    memcpy(data.data() + sizeof(ImageHeaderV2), mips.data(), sizeof(MipEntry) * mip);
 }
-Image<float> ImageLib::read_hdr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level) noexcept {
-    int32_t x, y, channel;
-    auto ptr = stbi_loadf(file_name.c_str(), &x, &y, &channel, 4);
-    auto img = _device.create_image<float>(PixelStorage::FLOAT4, x, y, mip_level);
-    cmd_buffer << img.copy_from(ptr) << [ptr] {
-        stbi_image_free(ptr);
-    };
-    if (mip_level > 1) {
-        generate_mip(img, cmd_buffer);
+void ImageLib::save_header(
+    luisa::span<std::byte> data,
+    uint32_t width, uint32_t height, uint32_t volume,
+    PixelStorage storage,
+    uint32_t mip,
+    bool checksum) noexcept {
+    using namespace imglib_detail;
+    luisa::vector<uint64_t> checksums;
+    if (checksum) {
+        checksums.resize(mip);
+        uint64_t offset = header_size(mip);
+        for (auto i : vstd::range(mip)) {
+            auto level = mip - 1 - i;
+            auto size = mip_byte_size(storage, width, height, volume, level);
+            checksums[level] = block_checksum(image_magic, data.data() + offset, size);
+            offset += size;
+        }
     }
-    return img;
+    write_header(data, width, height, volume, storage, mip, checksums);
 }
-Image<float> ImageLib::read_exr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level) noexcept {
-    float *ptr;
-    int32_t width, height;
-    char const *err;
-    if (LoadEXR(&ptr, &width, &height, file_name.c_str(), &err) < 0) {
-        LUISA_ERROR("Load EXR Error: {}", err);
+luisa::vector<std::byte> ImageLib::acquire_staging(StagingPool &pool, size_t size, CommandBuffer &cmd_buffer) noexcept {
+    auto chunk = pool.try_acquire(size);
+    if (chunk.empty()) {
+        // buffers in flight are released by callbacks of the work recorded so far
+        cmd_buffer << commit();
+        chunk = pool.acquire(size);
+    }
+    return chunk;
+}
+void ImageLib::write_chunk(StreamingSave &save, uint32_t level, size_t offset, luisa::span<std::byte const> data) noexcept {
+    using namespace imglib_detail;
+    if (save.checksum) {
+        if (save.checksums.empty()) {
+            save.checksums.resize(save.mip, image_magic);
+        }
+        save.checksums[level] = block_checksum(save.checksums[level], data.data(), data.size());
+    }
+    ProfileSpan span{this, "save.write", data.size()};
+    save.func(offset, data);
+}
+void ImageLib::finish_save(StreamingSave &save) noexcept {
+    luisa::vector<std::byte> header;
+    header.push_back_uninitialized(header_size(save.mip));
+    write_header(header, save.size.x, save.size.y, save.size.z, save.storage, save.mip, save.checksums);
+    ProfileSpan span{this, "save.write", header.size()};
+    save.func(0, header);
+}
+Image<float> ImageLib::upload_decoded(imglib_detail::DecodedImage &&decoded, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option) noexcept {
+    auto storage = decoded.storage;
+    if (decoded.storage == PixelStorage::FLOAT4) {
+        auto channels = option.native_channels ? decoded.channels : 4u;
+        if (channels == 1) {
+            storage = option.half ? PixelStorage::HALF1 : PixelStorage::FLOAT1;
+        } else if (channels == 2) {
+            storage = option.half ? PixelStorage::HALF2 : PixelStorage::FLOAT2;
+        } else {
+            storage = option.half ? PixelStorage::HALF4 : PixelStorage::FLOAT4;
+        }
     }
-    auto img = _device.create_image<float>(PixelStorage::FLOAT4, width, height, mip_level);
-    cmd_buffer << img.copy_from(ptr) << [ptr] {
-        free(ptr);
+    auto begin = profile_now();
+    auto img = [&] {
+        ProfileSpan span{this, "create_image"};
+        return _device.create_image<float>(storage, decoded.width, decoded.height, mip_level);
+    }();
+    auto release = [ptr = decoded.data, deleter = decoded.deleter] {
+        deleter(ptr);
     };
+    if (storage == decoded.storage) {
+        cmd_buffer << img.copy_from(decoded.data) << std::move(release);
+    } else {
+        // only the narrower image lives on after the upload, the write converts per texel
+        auto staging = _device.create_image<float>(decoded.storage, decoded.width, decoded.height);
+        cmd_buffer << staging.copy_from(decoded.data)
+                   << (*_convert_shader)(staging, img.view(0)).dispatch(img.size())
+                   << std::move(release)
+                   << [staging = std::move(staging)] {};
+    }
+    decoded.data = nullptr;
+    profile_device(cmd_buffer, "upload", begin, pixel_storage_size(decoded.storage, decoded.width, decoded.height, 1u));
     if (mip_level > 1) {
         generate_mip(img, cmd_buffer);
     }
     return img;
 }
-Image<float> ImageLib::read_exr_cubemap(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, float roughness) noexcept {
-    float *ptr;
-    int32_t width, height;
-    char const *err;
-    if (LoadEXR(&ptr, &width, &height, file_name.c_str(), &err) < 0) {
-        LUISA_ERROR("Load EXR Error: {}", err);
+Image<float> ImageLib::read_ldr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option) noexcept {
+    imglib_detail::DecodedImage decoded;
+    luisa::string error;
+    {
+        ProfileSpan span{this, "decode_ldr"};
+        decoded = imglib_detail::decode_ldr(file_name, error, option.native_channels);
     }
-    auto img = _device.create_image<float>(PixelStorage::FLOAT4, width, height, mip_level);
-    cmd_buffer << img.copy_from(ptr) << [ptr] {
-        free(ptr);
-    };
-    if (mip_level > 1) {
-        for (auto &&i : vstd::range(1, mip_level)) {
-            auto src_view = img.view(i - 1);
-            auto dst_view = img.view(i);
-            auto rate = float(i) / (mip_level - 1);
-            auto rough = 1 * (1 - rate) + roughness * rate;
-            cmd_buffer << (*_refl_map_gen)(src_view, make_float2(src_view.size()), dst_view, rough).dispatch(dst_view.size());
-        }
+    if (decoded.data == nullptr) {
+        LUISA_ERROR("{}", error);
     }
-    return img;
+    return upload_decoded(std::move(decoded), cmd_buffer, mip_level, option);
+}
+Image<float> ImageLib::read_hdr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option) noexcept {
+    imglib_detail::DecodedImage decoded;
+    luisa::string error;
+    {
+        ProfileSpan span{this, "decode_hdr"};
+        decoded = imglib_detail::decode_hdr(file_name, error);
+    }
+    if (decoded.data == nullptr) {
+        LUISA_ERROR("{}", error);
+    }
+    return upload_decoded(std::move(decoded), cmd_buffer, mip_level, option);
+}
+Image<float> ImageLib::read_exr(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, ReadOption option) noexcept {
+    return read_exr_region(file_name, cmd_buffer, mip_level, {}, option);
+}
+Image<float> ImageLib::read_exr_cubemap(luisa::string const &file_name, CommandBuffer &cmd_buffer, uint32_t mip_level, float roughness, PrefilterOption option) noexcept {
+    // mip 0 through the strip reader, then every mip from the prefilter
+    auto img = read_exr(file_name, cmd_buffer, 1);
+    if (mip_level <= 1) {
+        return img;
+    }
+    auto size = img.size();
+    auto chain = _device.create_image<float>(img.storage(), size.x, size.y, mip_level);
+    cmd_buffer << chain.view(0).copy_from(img.view(0))
+               << [img = std::move(img)] {};
+    generate_cubemap_mip(chain, cmd_buffer, roughness, option);
+    return chain;
 }
 
 namespace imglib_detail {
@@ -199,8 +532,74 @@ static void gen_mip_func(vstd::optional<Shader2D<Args...>> &shader, Device &devi
     };
     luisa::string file_name = "__gen_mip";
     file_name += vstd::to_string(mip_level);
-    auto path = (dir / file_name).string<char, std::char_traits<char>, luisa::allocator<char>>();
-    shader.New(device.compile_to(k, path));
+    compile_cached(shader, device, k, dir, file_name);
+}
+// box-filter weights of the source texels 2x, 2x + 1, 2x + 2 for one axis,
+// odd sizes use the three-tap footprint so no source texel is dropped
+static Float3 mip_axis_weights(Expr<uint> x, Expr<uint> src_size) noexcept {
+    auto dst_size = max(src_size / 2u, 1u);
+    auto inv = 1.0f / src_size.cast<float>();
+    auto odd = make_float3(
+        (dst_size - x).cast<float>() * inv,
+        dst_size.cast<float>() * inv,
+        (x + 1u).cast<float>() * inv);
+    auto even = select(make_float3(0.5f, 0.5f, 0.0f), make_float3(1.0f, 0.0f, 0.0f), src_size == 1u);
+    return select(even, odd, ((src_size & 1u) == 1u) && (src_size > 1u));
+}
+static void mip_npot(ImageVar<float> src, UInt2 src_size, ImageVar<float> dst) noexcept {
+    auto coord = dispatch_id().xy();
+    Float3 wx = mip_axis_weights(coord.x, src_size.x);
+    Float3 wy = mip_axis_weights(coord.y, src_size.y);
+    Float weight_x[3] = {wx.x, wx.y, wx.z};
+    Float weight_y[3] = {wy.x, wy.y, wy.z};
+    Float4 result = make_float4(0.0f);
+    for (auto y : vstd::range(3u)) {
+        for (auto x : vstd::range(3u)) {
+            auto offset = make_uint2(static_cast<uint>(x), static_cast<uint>(y));
+            auto src_coord = min(coord * make_uint2(2u) + offset, src_size - make_uint2(1u));
+            result += src.read(src_coord) * (weight_x[x] * weight_y[y]);
+        }
+    }
+    dst.write(coord, result);
+}
+static void mip_volume(VolumeVar<float> src, VolumeVar<float> dst) noexcept {
+    auto coord = dispatch_id();
+    Float4 result = make_float4(0.0f);
+    for (auto i : vstd::range(8u)) {
+        auto offset = make_uint3(i & 1u, (i >> 1u) & 1u, i >> 2u);
+        result += src.read(coord * make_uint3(2u) + offset);
+    }
+    dst.write(coord, result * 0.125f);
+}
+static void mip_volume_npot(VolumeVar<float> src, UInt3 src_size, VolumeVar<float> dst) noexcept {
+    auto coord = dispatch_id();
+    Float3 wx = mip_axis_weights(coord.x, src_size.x);
+    Float3 wy = mip_axis_weights(coord.y, src_size.y);
+    Float3 wz = mip_axis_weights(coord.z, src_size.z);
+    Float weight_x[3] = {wx.x, wx.y, wx.z};
+    Float weight_y[3] = {wy.x, wy.y, wy.z};
+    Float weight_z[3] = {wz.x, wz.y, wz.z};
+    Float4 result = make_float4(0.0f);
+    for (auto z : vstd::range(3u)) {
+        for (auto y : vstd::range(3u)) {
+            Float4 row = make_float4(0.0f);
+            for (auto x : vstd::range(3u)) {
+                auto offset = make_uint3(static_cast<uint>(x), static_cast<uint>(y), static_cast<uint>(z));
+                auto src_coord = min(coord * make_uint3(2u) + offset, src_size - make_uint3(1u));
+                row += src.read(src_coord) * weight_x[x];
+            }
+            result += row * (weight_y[y] * weight_z[z]);
+        }
+    }
+    dst.write(coord, result);
+}
+static uint32_t reverse_bits_host(uint32_t bits) noexcept {
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x00ff00ffu) << 8) | ((bits & 0xff00ff00u) >> 8);
+    bits = ((bits & 0x0f0f0f0fu) << 4) | ((bits & 0xf0f0f0f0u) >> 4);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xccccccccu) >> 2);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xaaaaaaaau) >> 1);
+    return bits;
 }
 static UInt reverse_bits(UInt bits) noexcept {
     bits = (bits << 16) | (bits >> 16);
@@ -213,7 +612,6 @@ static UInt reverse_bits(UInt bits) noexcept {
 static Float2 hammersley(UInt const &Index, UInt const &NumSamples) noexcept {
     return make_float2((Index.cast<float>() + 0.5f) / NumSamples.cast<float>(), (reverse_bits(Index).cast<float>() / 0xffffffffu));
 }
-constexpr float pi = 3.141592653589793f;
 
 Float3 ImportanceSampleGGX(Float3 const &N, Float2 const &E, Float const &Roughness) noexcept {
     auto m = Roughness * Roughness;
@@ -232,18 +630,6 @@ Float3 ImportanceSampleGGX(Float3 const &N, Float2 const &E, Float const &Roughn
 
     return normalize(TangentX * H.x + TangentY * H.y + N * H.z);
 }
-static Float2 DirToUv(Float3 w) noexcept {
-    Float theta = acos(w.y);
-    Float phi = atan2(w.x, w.z);
-    return fract(make_float2(1.f - 0.5f * inv_pi * phi, theta * inv_pi - 1.0f));
-}
-static Float3 UvToDir(Float2 uv) noexcept {
-    uv.x = 1.0f - uv.x;
-    Float phi = 2.f * pi * uv.x;
-    Float theta = pi * uv.y;
-    Float sin_theta = sin(theta);
-    return normalize(make_float3(sin(phi) * sin_theta, cos(theta), cos(phi) * sin_theta));
-};
 
 static Float3 refl(ImageVar<float> const &tex, Float2 const &img_size, Float3 const &sampleDir, Float const &roughness) noexcept {
     const uint32_t spp = 65536;
@@ -256,6 +642,62 @@ static Float3 refl(ImageVar<float> const &tex, Float2 const &img_size, Float3 co
     }
     return result;
 }
+luisa::vector<float4> refl_fis_samples(uint32_t spp, float roughness, float texel_solid_angle) noexcept {
+    luisa::vector<float4> samples;
+    auto m = roughness * roughness;
+    auto m2 = m * m;
+    // the GGX lobe degenerates to the mirror direction, its pdf is a delta
+    if (m2 < std::numeric_limits<float>::min()) {
+        samples.emplace_back(make_float4(0.0f, 0.0f, 1.0f, 0.0f));
+        return samples;
+    }
+    samples.reserve(spp);
+    for (auto i : vstd::range(spp)) {
+        auto e = make_float2((static_cast<float>(i) + 0.5f) / static_cast<float>(spp), static_cast<float>(reverse_bits_host(static_cast<uint32_t>(i))) / 4294967295.0f);
+        auto phi = 2.0f * pi * e.x;
+        auto cos_theta = std::sqrt((1.0f - e.y) / (1.0f + (m2 - 1.0f) * e.y));
+        auto sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+        auto h = make_float3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+        auto l = make_float3(2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f);
+        if (l.z <= 0.0f) {
+            continue;
+        }
+        // cos^2 (m2 - 1) + 1 without the cancellation at low roughness
+        auto d_denom = sin_theta * sin_theta + m2 * cos_theta * cos_theta;
+        auto pdf = m2 / (pi * d_denom * d_denom) * 0.25f;
+        auto sample_solid_angle = 1.0f / (static_cast<float>(spp) * pdf + 1e-6f);
+        auto lod = std::max(0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f, 0.0f);
+        samples.emplace_back(make_float4(l, lod));
+    }
+    return samples;
+}
+static void refl_fis(BindlessVar heap, BufferVar<float4> samples, UInt sample_count, UInt2 src_size, ImageVar<float> out_img) noexcept {
+    auto coord = dispatch_id().xy();
+    auto uv = (make_float2(coord) + float2{0.5f}) / make_float2(dispatch_size().xy());
+    auto n = UvToDir(uv);
+    auto up = select(select(float3{0, 1, 0}, float3{1, 0, 0}, abs(n.x) < 0.7f), float3{0, 0, 1}, abs(n.z) < 0.7f);
+    auto tangent_x = normalize(cross(up, n));
+    auto tangent_y = cross(n, tangent_x);
+    auto max_lod = log2(max(src_size.x, src_size.y).cast<float>());
+    Float3 result = make_float3(0.0f);
+    Float weight = 0.0f;
+    for (auto i : range(sample_count)) {
+        auto s = samples.read(i);
+        auto l = normalize(tangent_x * s.x + tangent_y * s.y + n * s.z);
+        // lat-long texels shrink by sin(theta) towards the poles
+        auto sin_theta = sqrt(max(1.0f - l.y * l.y, 1e-4f));
+        auto lod = clamp(s.w - 0.5f * log2(sin_theta), 0.0f, max_lod);
+        // u wraps around the seam, v stays inside the half texel of the coarser level read by the trilinear filter
+        auto level_height = max(src_size.y >> (lod.cast<uint>() + 1u), 1u).cast<float>();
+        auto border = 0.5f / level_height;
+        auto sample_uv = DirToUv(l);
+        sample_uv.y = clamp(sample_uv.y, border, 1.0f - border);
+        auto color = heap.tex2d(0u).sample(sample_uv, lod).xyz();
+        result += clamp(color, float3{0.0f}, float3{256.0f}) * s.z;
+        weight += s.z;
+    }
+    out_img.write(coord, make_float4(result / max(weight, 1e-4f), 1.0f));
+}
 static void refl_cubegen(ImageVar<float> read_img, Float2 img_size, ImageVar<float> out_img, Float roughness) {
     auto coord = dispatch_id().xy();
     auto uv = (make_float2(coord) + float2{0.5f}) / make_float2(dispatch_size().xy());
@@ -263,8 +705,14 @@ static void refl_cubegen(ImageVar<float> read_img, Float2 img_size, ImageVar<flo
     auto color = refl(read_img, img_size, dir, roughness);
     out_img.write(coord, make_float4(color, 1.0f));
 };
+// the storage of out_img drops the extra channels and rounds to its precision
+static void convert_storage(ImageVar<float> src_img, ImageVar<float> out_img) noexcept {
+    auto coord = dispatch_id().xy();
+    out_img.write(coord, src_img.read(coord));
+}
 }// namespace imglib_detail
-ImageLib::ImageLib(Device device, luisa::string shader_dir) noexcept : _device(std::move(device)), _path(shader_dir) {
+ImageLib::ImageLib(Device device, luisa::string shader_dir) noexcept
+    : _device(std::move(device)), _profiler(luisa::make_unique<imglib_detail::Profiler>()), _path(shader_dir) {
     using namespace imglib_detail;
     std::filesystem::path path(shader_dir);
     _mip1_shader.init_func = [this](auto &&opt) { gen_mip_func(opt, _device, 1, _path); };
@@ -272,38 +720,159 @@ ImageLib::ImageLib(Device device, luisa::string shader_dir) noexcept : _device(s
     _mip3_shader.init_func = [this](auto &&opt) { gen_mip_func(opt, _device, 3, _path); };
     _mip4_shader.init_func = [this](auto &&opt) { gen_mip_func(opt, _device, 4, _path); };
     _mip5_shader.init_func = [this](auto &&opt) { gen_mip_func(opt, _device, 5, _path); };
+    _mip_npot_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{mip_npot}, _path, "__gen_mip_npot");
+    };
+    _mip_volume_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel3D{mip_volume}, _path, "__gen_mip_volume");
+    };
+    _mip_volume_npot_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel3D{mip_volume_npot}, _path, "__gen_mip_volume_npot");
+    };
     _refl_map_gen.init_func = [this](auto &&opt) {
-        opt.New(_device.compile_to(Kernel2D{refl_cubegen}, "__refl_gen"));
+        compile_cached(opt, _device, Kernel2D{refl_cubegen}, _path, "__refl_gen");
+    };
+    _refl_fis_gen.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{refl_fis}, _path, "__refl_fis_gen");
     };
+    _convert_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{convert_storage}, _path, "__convert_storage");
+    };
+    init_sh_shaders();
+    init_cube_shaders();
+    init_exr_shaders();
+    _bc1_shader.init_func = [this](auto &&opt) { compile_bc_shader(opt, _device, PixelStorage::BC1, _path); };
+    _bc3_shader.init_func = [this](auto &&opt) { compile_bc_shader(opt, _device, PixelStorage::BC3, _path); };
+    _bc4_shader.init_func = [this](auto &&opt) { compile_bc_shader(opt, _device, PixelStorage::BC4, _path); };
+    _bc5_shader.init_func = [this](auto &&opt) { compile_bc_shader(opt, _device, PixelStorage::BC5, _path); };
+    _bc6_shader.init_func = [this](auto &&opt) { compile_bc_shader(opt, _device, PixelStorage::BC6, _path); };
+    _bc7_shader.init_func = [this](auto &&opt) { compile_bc_shader(opt, _device, PixelStorage::BC7, _path); };
+    add_warm_up(WARM_UP_MIP, "gen_mip1", _mip1_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip2", _mip2_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip3", _mip3_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip4", _mip4_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip5", _mip5_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip_npot", _mip_npot_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip_volume", _mip_volume_shader);
+    add_warm_up(WARM_UP_MIP, "gen_mip_volume_npot", _mip_volume_npot_shader);
+    add_warm_up(WARM_UP_CUBEMAP, "refl_gen", _refl_map_gen);
+    add_warm_up(WARM_UP_CUBEMAP, "refl_fis_gen", _refl_fis_gen);
+    add_warm_up(WARM_UP_READ, "convert_storage", _convert_shader);
+    add_warm_up(WARM_UP_COMPRESS, "bc1", _bc1_shader);
+    add_warm_up(WARM_UP_COMPRESS, "bc3", _bc3_shader);
+    add_warm_up(WARM_UP_COMPRESS, "bc4", _bc4_shader);
+    add_warm_up(WARM_UP_COMPRESS, "bc5", _bc5_shader);
+    add_warm_up(WARM_UP_COMPRESS, "bc6", _bc6_shader);
+    add_warm_up(WARM_UP_COMPRESS, "bc7", _bc7_shader);
+}
+ImageLib::~ImageLib() noexcept = default;
+ImageLib::WarmUpStats ImageLib::warm_up(uint32_t flags, uint32_t thread_count) noexcept {
+    luisa::vector<WarmUpEntry const *> entries;
+    for (auto &&i : _warm_up_entries) {
+        if ((i.flags & flags) != 0) {
+            entries.emplace_back(&i);
+        }
+    }
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    thread_count = std::min<uint32_t>(thread_count, entries.size());
+    Clock total_clock;
+    std::atomic_size_t next{0};
+    luisa::vector<double> times(entries.size());
+    auto work = [&] {
+        for (auto i = next.fetch_add(1); i < entries.size(); i = next.fetch_add(1)) {
+            Clock clock;
+            entries[i]->init();
+            times[i] = clock.toc();
+        }
+    };
+    luisa::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back(work);
+    }
+    for (auto &&i : threads) {
+        i.join();
+    }
+    WarmUpStats stats;
+    stats.shader_count = static_cast<uint32_t>(entries.size());
+    stats.total_ms = total_clock.toc();
+    for (auto i : vstd::range(entries.size())) {
+        LUISA_INFO("Shader {} ready in {} ms.", entries[i]->name, times[i]);
+        stats.shader_ms += times[i];
+    }
+    LUISA_INFO("Warmed up {} shaders in {} ms ({} ms of compile time).", stats.shader_count, stats.total_ms, stats.shader_ms);
+    return stats;
 }
 void ImageLib::generate_mip(Image<float> const &img, CommandBuffer &cmd_buffer) noexcept {
-    switch (img.mip_levels()) {
-        case 0:
-        case 1:
-            return;
-        case 2:
-            cmd_buffer << (*_mip1_shader)(img.view(0), img.view(1)).dispatch(img.size());
-            return;
-        case 3:
-            cmd_buffer << (*_mip2_shader)(img.view(0), img.view(1), img.view(2)).dispatch(img.size());
-            return;
-        case 4:
-            cmd_buffer << (*_mip3_shader)(img.view(0), img.view(1), img.view(2), img.view(3)).dispatch(img.size());
-            return;
-        case 5:
-            cmd_buffer << (*_mip4_shader)(img.view(0), img.view(1), img.view(2), img.view(3), img.view(4)).dispatch(img.size());
-            return;
-        case 6:
-            cmd_buffer << (*_mip5_shader)(img.view(0), img.view(1), img.view(2), img.view(3), img.view(4), img.view(5)).dispatch(img.size());
-            return;
-        default:
-            LUISA_ERROR("Mip-level larger than 6 can-not be supported!");
-            return;
-    }
-}
-void ImageLib::generate_cubemap_mip(Image<float> const &img, CommandBuffer &cmd_buffer, float roughness) noexcept {
+    if (imglib_detail::is_block_compressed(img.storage())) {
+        LUISA_ERROR("Can not generate mip for block-compressed image, generate before compress.");
+    }
+    auto begin = profile_now();
     auto mip_level = img.mip_levels();
-    if (mip_level > 1) {
+    // largest k such that 2^k divides x
+    auto pow2_levels = [](uint32_t x) noexcept {
+        uint32_t k = 0;
+        while (x > 1 && (x & 1u) == 0) {
+            x >>= 1;
+            k++;
+        }
+        return k;
+    };
+    // fuse up to 5 levels per dispatch while the size is divisible by the block size,
+    // fall back to one odd-size-aware dispatch per level otherwise
+    uint32_t level = 0;
+    while (level + 1 < mip_level) {
+        auto size = img.view(level).size();
+        auto fused = std::min({mip_level - 1 - level, 5u, pow2_levels(size.x), pow2_levels(size.y)});
+        auto v = [&](uint32_t i) { return img.view(level + i); };
+        switch (fused) {
+            case 0:
+                cmd_buffer << (*_mip_npot_shader)(v(0), size, v(1)).dispatch(v(1).size());
+                fused = 1;
+                break;
+            case 1:
+                cmd_buffer << (*_mip1_shader)(v(0), v(1)).dispatch(size);
+                break;
+            case 2:
+                cmd_buffer << (*_mip2_shader)(v(0), v(1), v(2)).dispatch(size);
+                break;
+            case 3:
+                cmd_buffer << (*_mip3_shader)(v(0), v(1), v(2), v(3)).dispatch(size);
+                break;
+            case 4:
+                cmd_buffer << (*_mip4_shader)(v(0), v(1), v(2), v(3), v(4)).dispatch(size);
+                break;
+            default:
+                cmd_buffer << (*_mip5_shader)(v(0), v(1), v(2), v(3), v(4), v(5)).dispatch(size);
+                break;
+        }
+        level += fused;
+    }
+    profile_device(cmd_buffer, "generate_mip", begin, img.byte_size());
+}
+void ImageLib::generate_volume_mip(Volume<float> const &volume, CommandBuffer &cmd_buffer) noexcept {
+    auto begin = profile_now();
+    for (auto level : vstd::range(1u, volume.mip_levels())) {
+        auto src = volume.view(level - 1);
+        auto dst = volume.view(level);
+        auto size = src.size();
+        if (size.x % 2 == 0 && size.y % 2 == 0 && size.z % 2 == 0) {
+            cmd_buffer << (*_mip_volume_shader)(src, dst).dispatch(dst.size());
+        } else {
+            cmd_buffer << (*_mip_volume_npot_shader)(src, size, dst).dispatch(dst.size());
+        }
+    }
+    profile_device(cmd_buffer, "generate_volume_mip", begin, volume.byte_size());
+}
+void ImageLib::generate_cubemap_mip(Image<float> const &img, CommandBuffer &cmd_buffer, float roughness, PrefilterOption option) noexcept {
+    auto mip_level = img.mip_levels();
+    if (mip_level <= 1) {
+        return;
+    }
+    auto begin = profile_now();
+    if (option.mode == PrefilterMode::REFERENCE) {
         for (auto &&i : vstd::range(1, mip_level)) {
             auto src_view = img.view(i - 1);
             auto dst_view = img.view(i);
@@ -311,7 +880,44 @@ void ImageLib::generate_cubemap_mip(Image<float> const &img, CommandBuffer &cmd_
             auto rough = 1 * (1 - rate) + roughness * rate;
             cmd_buffer << (*_refl_map_gen)(src_view, make_float2(src_view.size()), dst_view, rough).dispatch(dst_view.size());
         }
+        profile_device(cmd_buffer, "generate_cubemap_mip", begin, img.byte_size());
+        return;
+    }
+    // every level is filtered from a box-filtered chain of mip 0
+    auto size = img.size();
+    uint32_t chain_level = 1;
+    while ((std::max(size.x, size.y) >> chain_level) > 0) {
+        chain_level++;
+    }
+    // same storage as img, image copies do not convert
+    auto chain = _device.create_image<float>(img.storage(), size.x, size.y, chain_level);
+    cmd_buffer << chain.view(0).copy_from(img.view(0));
+    generate_mip(chain, cmd_buffer);
+    auto heap = _device.create_bindless_array(1);
+    // one address mode for both axes: repeat for the u seam, refl_fis clamps v at the poles itself
+    heap.emplace(0, chain, Sampler::linear_linear_repeat());
+    cmd_buffer << heap.update();
+    // one sample table per roughness level, shared by all texels of that level
+    luisa::vector<float4> samples;
+    luisa::vector<std::pair<size_t, size_t>> ranges;
+    for (auto &&i : vstd::range(1, mip_level)) {
+        auto rate = float(i) / (mip_level - 1);
+        auto rough = 1 * (1 - rate) + roughness * rate;
+        // solid angle of a texel on the equator of the lat-long map
+        auto texel_solid_angle = 2.0f * imglib_detail::pi * imglib_detail::pi / (static_cast<float>(size.x) * static_cast<float>(size.y));
+        auto level_samples = imglib_detail::refl_fis_samples(option.sample_count, rough, texel_solid_angle);
+        ranges.emplace_back(samples.size(), level_samples.size());
+        samples.insert(samples.end(), level_samples.begin(), level_samples.end());
+    }
+    auto sample_buffer = _device.create_buffer<float4>(samples.size());
+    cmd_buffer << sample_buffer.copy_from(samples.data());
+    for (auto &&i : vstd::range(1, mip_level)) {
+        auto dst_view = img.view(i);
+        auto [offset, count] = ranges[i - 1];
+        cmd_buffer << (*_refl_fis_gen)(heap, sample_buffer.view(offset, count), static_cast<uint32_t>(count), size, dst_view).dispatch(dst_view.size());
     }
+    cmd_buffer << [chain = std::move(chain), heap = std::move(heap), sample_buffer = std::move(sample_buffer), samples = std::move(samples)] {};
+    profile_device(cmd_buffer, "generate_cubemap_mip", begin, img.byte_size());
 }
 
 }// namespace luisa::compute
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "mapped_file.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace luisa::compute {
+#ifdef _WIN32
+MappedFile::MappedFile(std::filesystem::path const &path) noexcept {
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+    auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return;
+    }
+    auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<std::byte const *>(data);
+    _size = static_cast<size_t>(size.QuadPart);
+}
+void MappedFile::_release() noexcept {
+    if (_data) UnmapViewOfFile(_data);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file) CloseHandle(_file);
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = nullptr;
+    _size = 0;
+}
+MappedFile::MappedFile(MappedFile &&rhs) noexcept
+    : _data(rhs._data), _size(rhs._size), _file(rhs._file), _mapping(rhs._mapping) {
+    rhs._data = nullptr;
+    rhs._size = 0;
+    rhs._file = nullptr;
+    rhs._mapping = nullptr;
+}
+MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept {
+    if (this != &rhs) {
+        _release();
+        _data = rhs._data;
+        _size = rhs._size;
+        _file = rhs._file;
+        _mapping = rhs._mapping;
+        rhs._data = nullptr;
+        rhs._size = 0;
+        rhs._file = nullptr;
+        rhs._mapping = nullptr;
+    }
+    return *this;
+}
+#else
+MappedFile::MappedFile(std::filesystem::path const &path) noexcept {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (data == MAP_FAILED) return;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    _data = static_cast<std::byte const *>(data);
+    _size = static_cast<size_t>(st.st_size);
+}
+void MappedFile::_release() noexcept {
+    if (_data) munmap(const_cast<std::byte *>(_data), _size);
+    _data = nullptr;
+    _size = 0;
+}
+MappedFile::MappedFile(MappedFile &&rhs) noexcept
+    : _data(rhs._data), _size(rhs._size) {
+    rhs._data = nullptr;
+    rhs._size = 0;
+}
+MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept {
+    if (this != &rhs) {
+        _release();
+        _data = rhs._data;
+        _size = rhs._size;
+        rhs._data = nullptr;
+        rhs._size = 0;
+    }
+    return *this;
+}
+#endif
+MappedFile::~MappedFile() noexcept {
+    _release();
+}
+}// namespace luisa::compute
@@ -0,0 +1,27 @@
+#pragma once
+#include <vstl/common.h>
+#include <filesystem>
+
+namespace luisa::compute {
+// Read-only memory mapping of a whole file, the mapping is released on destruction
+class MappedFile {
+    std::byte const *_data{nullptr};
+    size_t _size{0};
+#ifdef _WIN32
+    void *_file{nullptr};
+    void *_mapping{nullptr};
+#endif
+    void _release() noexcept;
+
+public:
+    explicit MappedFile(std::filesystem::path const &path) noexcept;
+    MappedFile(MappedFile &&rhs) noexcept;
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile &&rhs) noexcept;
+    MappedFile &operator=(MappedFile const &) = delete;
+    ~MappedFile() noexcept;
+    [[nodiscard]] bool valid() const noexcept { return _data != nullptr; }
+    [[nodiscard]] luisa::span<std::byte const> bytes() const noexcept { return {_data, _size}; }
+    [[nodiscard]] size_t size() const noexcept { return _size; }
+};
+}// namespace luisa::compute
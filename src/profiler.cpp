@@ -0,0 +1,86 @@
+#include "profiler.h"
+#include <core/logging.h>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+namespace luisa::compute {
+namespace imglib_detail {
+void Profiler::record(luisa::string_view name, uint32_t lane, double begin_ms, double end_ms, size_t bytes) noexcept {
+    auto duration = end_ms - begin_ms;
+    std::lock_guard lck{mtx};
+    auto iter = std::find_if(stats.begin(), stats.end(), [&](auto &&s) { return s.name == name; });
+    if (iter == stats.end()) {
+        stats.emplace_back(ImageLib::PhaseStats{.name = luisa::string{name}});
+        iter = stats.end() - 1;
+    }
+    iter->count++;
+    iter->total_ms += duration;
+    iter->max_ms = std::max(iter->max_ms, duration);
+    iter->bytes += bytes;
+    if (events.size() < max_trace_events) {
+        events.push_back(TraceEvent{luisa::string{name}, lane, begin_ms, end_ms, bytes});
+    }
+}
+uint32_t Profiler::host_lane() noexcept {
+    static std::atomic_uint32_t next_lane{1};
+    thread_local uint32_t lane = next_lane.fetch_add(1, std::memory_order_relaxed);
+    return lane;
+}
+}// namespace imglib_detail
+ImageLib::ProfileSpan::ProfileSpan(ImageLib *lib, luisa::string_view name, size_t bytes) noexcept
+    : _lib(lib), _name(name), _begin(lib->profile_now()), bytes(bytes) {}
+ImageLib::ProfileSpan::~ProfileSpan() noexcept {
+    if (_begin >= 0) {
+        auto &&profiler = *_lib->_profiler;
+        profiler.record(_name, imglib_detail::Profiler::host_lane(), _begin, profiler.clock.toc(), bytes);
+    }
+}
+double ImageLib::profile_now() const noexcept {
+    if (!_profiler->enabled.load(std::memory_order_relaxed)) {
+        return -1.0;
+    }
+    return _profiler->clock.toc();
+}
+void ImageLib::profile_device(CommandBuffer &cmd_buffer, luisa::string_view name, double begin, size_t bytes) noexcept {
+    if (begin < 0) {
+        return;
+    }
+    cmd_buffer << [profiler = _profiler.get(), name = luisa::string{name}, begin, bytes] {
+        profiler->record(name, 0, begin, profiler->clock.toc(), bytes);
+    };
+}
+void ImageLib::set_profiling(bool enabled) noexcept {
+    _profiler->enabled.store(enabled, std::memory_order_relaxed);
+}
+luisa::vector<ImageLib::PhaseStats> ImageLib::profile_stats() const noexcept {
+    std::lock_guard lck{_profiler->mtx};
+    return _profiler->stats;
+}
+void ImageLib::reset_profile() noexcept {
+    std::lock_guard lck{_profiler->mtx};
+    _profiler->stats.clear();
+    _profiler->events.clear();
+}
+bool ImageLib::dump_trace(std::filesystem::path const &path) const noexcept {
+    luisa::string json = "{\"traceEvents\":[\n"
+                         "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"device\"}}";
+    {
+        std::lock_guard lck{_profiler->mtx};
+        for (auto &&e : _profiler->events) {
+            json += luisa::format(
+                ",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"bytes\":{}}}}}",
+                e.name, e.lane == 0 ? "device" : "host", e.lane, e.begin_ms * 1e3, (e.end_ms - e.begin_ms) * 1e3, e.bytes);
+        }
+    }
+    json += "\n]}\n";
+    auto file = std::fopen(path.string().c_str(), "wb");
+    if (file == nullptr) {
+        LUISA_WARNING("Can not write trace to {}.", path.string());
+        return false;
+    }
+    auto written = std::fwrite(json.data(), 1, json.size(), file);
+    std::fclose(file);
+    return written == json.size();
+}
+}// namespace luisa::compute
@@ -0,0 +1,28 @@
+#pragma once
+#include <tools/image_lib.h>
+#include <core/clock.h>
+#include <atomic>
+#include <mutex>
+
+namespace luisa::compute::imglib_detail {
+struct TraceEvent {
+    luisa::string name;
+    // 0 is the device queue, host threads count from 1
+    uint32_t lane;
+    double begin_ms;
+    double end_ms;
+    size_t bytes;
+};
+// spans of every ImageLib phase, aggregated per name and kept as trace events
+struct Profiler {
+    // the trace keeps the first events only, the stats cover everything
+    static constexpr size_t max_trace_events = 1u << 20u;
+    std::atomic_bool enabled{false};
+    Clock clock;
+    mutable std::mutex mtx;
+    luisa::vector<TraceEvent> events;
+    luisa::vector<ImageLib::PhaseStats> stats;
+    void record(luisa::string_view name, uint32_t lane, double begin_ms, double end_ms, size_t bytes) noexcept;
+    [[nodiscard]] static uint32_t host_lane() noexcept;
+};
+}// namespace luisa::compute::imglib_detail
@@ -0,0 +1,114 @@
+#include <tools/image_lib.h>
+#include <dsl/syntax.h>
+#include <dsl/sugar.h>
+#include <core/logging.h>
+#include "env_map.h"
+#include "shader_cache.h"
+
+namespace luisa::compute {
+namespace imglib_detail {
+static constexpr uint32_t sh_block_size = 16;
+// real SH basis of bands [0, order), in the axes of the directions returned by UvToDir
+static void sh_basis(Expr<float3> d, uint32_t order, Float (&basis)[ImageLib::max_sh_order * ImageLib::max_sh_order]) noexcept {
+    auto x = d.x;
+    auto y = d.y;
+    auto z = d.z;
+    basis[0] = 0.282095f;
+    if (order > 1) {
+        basis[1] = 0.488603f * y;
+        basis[2] = 0.488603f * z;
+        basis[3] = 0.488603f * x;
+    }
+    if (order > 2) {
+        basis[4] = 1.092548f * x * y;
+        basis[5] = 1.092548f * y * z;
+        basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+        basis[7] = 1.092548f * x * z;
+        basis[8] = 0.546274f * (x * x - y * y);
+    }
+    if (order > 3) {
+        basis[9] = 0.590044f * y * (3.0f * x * x - y * y);
+        basis[10] = 2.890611f * x * y * z;
+        basis[11] = 0.457046f * y * (5.0f * z * z - 1.0f);
+        basis[12] = 0.373176f * z * (5.0f * z * z - 3.0f);
+        basis[13] = 0.457046f * x * (5.0f * z * z - 1.0f);
+        basis[14] = 1.445306f * z * (x * x - y * y);
+        basis[15] = 0.590044f * x * (x * x - 3.0f * y * y);
+    }
+}
+// every block reduces radiance * solid angle * Y_k of its texels to one partial sum per coefficient
+static void compile_sh_project(vstd::optional<Shader2D<Image<float>, uint2, Buffer<float4>>> &shader, Device &device, uint32_t order, std::filesystem::path const &dir) noexcept {
+    auto coeff_count = order * order;
+    Kernel2D k = [&](ImageVar<float> img, UInt2 size, BufferVar<float4> partials) {
+        set_block_size(sh_block_size, sh_block_size);
+        auto coord = dispatch_id().xy();
+        auto valid = all(coord < size);
+        auto fsize = make_float2(size);
+        auto uv = (make_float2(coord) + float2{0.5f}) / fsize;
+        auto dir = UvToDir(uv);
+        // solid angle of the lat-long texel
+        auto weight = 2.0f * pi * pi * sin(pi * uv.y) / (fsize.x * fsize.y);
+        Float3 radiance = select(make_float3(0.0f), img.read(min(coord, size - make_uint2(1u))).xyz() * weight, valid);
+        Float basis[ImageLib::max_sh_order * ImageLib::max_sh_order];
+        sh_basis(dir, order, basis);
+        Shared<float4> shared{sh_block_size * sh_block_size};
+        auto tid = thread_id().y * sh_block_size + thread_id().x;
+        auto block_index = block_id().y * (dispatch_size().x / sh_block_size) + block_id().x;
+        for (auto c : vstd::range(coeff_count)) {
+            shared.write(tid, make_float4(radiance * basis[c], 0.0f));
+            sync_block();
+            for (auto stride = sh_block_size * sh_block_size / 2; stride > 0; stride /= 2) {
+                $if(tid < stride) {
+                    shared.write(tid, shared.read(tid) + shared.read(tid + stride));
+                };
+                sync_block();
+            }
+            $if(tid == 0u) {
+                partials.write(block_index * coeff_count + static_cast<uint>(c), shared.read(0u));
+            };
+            sync_block();
+        }
+    };
+    luisa::string file_name = "__sh_project";
+    file_name += vstd::to_string(order);
+    compile_cached(shader, device, k, dir, file_name);
+}
+static void sh_reduce(BufferVar<float4> partials, UInt block_count, UInt coeff_count, BufferVar<float4> result) noexcept {
+    auto c = dispatch_id().x;
+    Float4 sum = make_float4(0.0f);
+    for (auto b : range(block_count)) {
+        sum += partials.read(b * coeff_count + c);
+    }
+    result.write(c, sum);
+}
+}// namespace imglib_detail
+void ImageLib::init_sh_shaders() noexcept {
+    using namespace imglib_detail;
+    for (auto i : vstd::range(max_sh_order)) {
+        _sh_project_shader[i].init_func = [this, order = static_cast<uint32_t>(i + 1)](auto &&opt) { compile_sh_project(opt, _device, order, _path); };
+        add_warm_up(WARM_UP_SH, luisa::format("sh_project{}", i + 1), _sh_project_shader[i]);
+    }
+    _sh_reduce_shader.init_func = [this](auto &&opt) {
+        compile_cached(opt, _device, Kernel2D{sh_reduce}, _path, "__sh_reduce");
+    };
+    add_warm_up(WARM_UP_SH, "sh_reduce", _sh_reduce_shader);
+}
+Buffer<float4> ImageLib::project_sh(Image<float> const &img, uint32_t order, CommandBuffer &cmd_buffer) noexcept {
+    using imglib_detail::sh_block_size;
+    if (order == 0 || order > max_sh_order) {
+        LUISA_ERROR("SH order must be in [1, {}], got {}.", max_sh_order, order);
+    }
+    auto begin = profile_now();
+    auto coeff_count = order * order;
+    auto size = img.size();
+    auto blocks = make_uint2((size.x + sh_block_size - 1) / sh_block_size, (size.y + sh_block_size - 1) / sh_block_size);
+    auto block_count = blocks.x * blocks.y;
+    auto partials = _device.create_buffer<float4>(block_count * coeff_count);
+    auto result = _device.create_buffer<float4>(coeff_count);
+    cmd_buffer << (*_sh_project_shader[order - 1])(img.view(0), size, partials).dispatch(blocks * sh_block_size)
+               << (*_sh_reduce_shader)(partials, block_count, coeff_count, result).dispatch(coeff_count, 1u)
+               << [partials = std::move(partials)] {};
+    profile_device(cmd_buffer, "project_sh", begin, img.view(0).byte_size());
+    return result;
+}
+}// namespace luisa::compute
@@ -0,0 +1,16 @@
+#pragma once
+#include <runtime/device.h>
+#include <core/logging.h>
+#include <vstl/common.h>
+#include <filesystem>
+
+namespace luisa::compute::imglib_detail {
+// The cached binary is named after the hash of the kernel, which covers its AST and every
+// parameter baked into it, so a warm start reuses it and a changed kernel never hits a stale one
+template<typename S, typename K>
+void compile_cached(vstd::optional<S> &shader, Device &device, K const &kernel, std::filesystem::path const &dir, luisa::string_view name) noexcept {
+    auto file_name = luisa::format("{}_{:016x}", name, kernel.function()->hash());
+    auto path = (dir / file_name.c_str()).string<char, std::char_traits<char>, luisa::allocator<char>>();
+    shader.New(device.compile_to(kernel, path));
+}
+}// namespace luisa::compute::imglib_detail
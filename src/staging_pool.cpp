@@ -0,0 +1,77 @@
+#include <tools/staging_pool.h>
+#include <algorithm>
+
+namespace luisa::compute {
+namespace imglib_detail {
+static constexpr size_t staging_granularity = 1ull << 20u;
+}// namespace imglib_detail
+StagingPool::StagingPool(size_t budget, size_t chunk_size) noexcept
+    : _budget(std::max(budget, imglib_detail::staging_granularity)),
+      _chunk_size(std::max(std::min(chunk_size, _budget) / imglib_detail::staging_granularity, size_t{1}) * imglib_detail::staging_granularity) {}
+StagingPool::~StagingPool() noexcept = default;
+bool StagingPool::_fits(size_t size) const noexcept {
+    return _in_use == 0 || _in_use + size <= _budget;
+}
+luisa::vector<std::byte> StagingPool::_take(size_t size) noexcept {
+    luisa::vector<std::byte> result;
+    // smallest cached buffer that is large enough, the whole capacity is charged so it must fit too
+    auto best = _free.end();
+    for (auto iter = _free.begin(); iter != _free.end(); ++iter) {
+        if (iter->capacity() >= size && _fits(iter->capacity()) &&
+            (best == _free.end() || iter->capacity() < best->capacity())) {
+            best = iter;
+        }
+    }
+    if (best != _free.end()) {
+        result = std::move(*best);
+        _free.erase(best);
+        _cached -= result.capacity();
+        result.clear();
+        result.push_back_uninitialized(size);
+    } else {
+        // make room in the budget for the new allocation
+        while (!_free.empty() && _in_use + _cached + size > _budget) {
+            _cached -= _free.back().capacity();
+            _free.pop_back();
+        }
+        result.reserve(size);
+        result.push_back_uninitialized(size);
+    }
+    _in_use += result.capacity();
+    _peak = std::max(_peak, _in_use);
+    return result;
+}
+size_t StagingPool::peak_bytes() noexcept {
+    std::lock_guard lck{_mtx};
+    return _peak;
+}
+luisa::vector<std::byte> StagingPool::try_acquire(size_t size) noexcept {
+    std::lock_guard lck{_mtx};
+    if (!_fits(size)) {
+        return {};
+    }
+    return _take(size);
+}
+luisa::vector<std::byte> StagingPool::acquire(size_t size) noexcept {
+    std::unique_lock lck{_mtx};
+    _cv.wait(lck, [&] { return _fits(size); });
+    return _take(size);
+}
+void StagingPool::release(luisa::vector<std::byte> buffer) noexcept {
+    {
+        std::lock_guard lck{_mtx};
+        auto capacity = buffer.capacity();
+        _in_use -= capacity;
+        if (_in_use + _cached + capacity <= _budget) {
+            _cached += capacity;
+            _free.emplace_back(std::move(buffer));
+        }
+    }
+    _cv.notify_all();
+}
+void StagingPool::trim() noexcept {
+    std::lock_guard lck{_mtx};
+    _free.clear();
+    _cached = 0;
+}
+}// namespace luisa::compute
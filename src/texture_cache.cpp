@@ -0,0 +1,211 @@
+#include <tools/texture_cache.h>
+#include <core/logging.h>
+#include "mapped_file.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdio>
+#include <random>
+
+namespace luisa::compute {
+namespace imglib_detail {
+// bump when the processing of a cached texture changes, so old entries are never hit
+static constexpr uint32_t cache_version = 1u;
+static constexpr char const *cache_extension = ".lcim";
+static constexpr char const *temp_extension = ".tmp";
+// temporary files older than this belong to a crashed writer
+static constexpr auto stale_temp_age = std::chrono::hours{1};
+// std::fseek takes a long, which is 32 bits on Windows
+static bool seek_file(std::FILE *file, uint64_t offset) noexcept {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+struct CacheWrite {
+    std::FILE *file{nullptr};
+    std::filesystem::path temp_path;
+    std::filesystem::path final_path;
+    // any chunk failed, the entry is never renamed into place
+    bool failed{false};
+    ~CacheWrite() noexcept {
+        if (file != nullptr) {
+            std::fclose(file);
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+        }
+    }
+};
+}// namespace imglib_detail
+TextureCache::TextureCache(ImageLib &lib, std::filesystem::path dir, size_t max_bytes) noexcept
+    : _lib(lib), _dir(std::move(dir)), _max_bytes(max_bytes) {
+    std::error_code ec;
+    std::filesystem::create_directories(_dir, ec);
+    if (ec) {
+        LUISA_WARNING("Can not create texture cache directory {}: {}.", _dir.string(), ec.message());
+    }
+}
+TextureCache::~TextureCache() noexcept = default;
+uint64_t TextureCache::_key(std::filesystem::path const &source, Params const &params) const noexcept {
+    MappedFile file{source};
+    if (!file.valid()) {
+        LUISA_ERROR("Can not open texture source {}.", source.string());
+    }
+    uint64_t key = imglib_detail::cache_version;
+    auto bytes = file.bytes();
+    for (size_t offset = 0; offset < bytes.size(); offset += 1u << 20u) {
+        key = luisa::hash64(bytes.data() + offset, std::min<size_t>(bytes.size() - offset, 1u << 20u), key);
+    }
+    // explicit fields, no padding bytes in the key
+    uint32_t fields[] = {
+        params.mip_level,
+        params.prefilter ? 1u : 0u,
+        std::bit_cast<uint32_t>(params.prefilter ? params.roughness : 0.0f),
+        params.prefilter ? static_cast<uint32_t>(params.prefilter_option.mode) : 0u,
+        params.prefilter ? params.prefilter_option.sample_count : 0u,
+        params.read_option.native_channels ? 1u : 0u,
+        params.read_option.half ? 1u : 0u};
+    return luisa::hash64(fields, sizeof(fields), key);
+}
+Image<float> TextureCache::_process(std::filesystem::path const &source, Params const &params, CommandBuffer &cmd_buffer) noexcept {
+    auto ext = source.extension().string();
+    for (auto &&c : ext) {
+        c = static_cast<char>(std::tolower(c));
+    }
+    luisa::string file_name{source.string().c_str()};
+    if (params.prefilter) {
+        if (ext != ".exr" && ext != ".hdr") {
+            LUISA_ERROR("Texture cache can only prefilter lat-long .exr or .hdr environment maps, got {}.", source.string());
+        }
+        // mip 0 only, the prefilter replaces the box-filtered chain
+        auto image = ext == ".exr" ? _lib.read_exr(file_name, cmd_buffer, 1, params.read_option) : _lib.read_hdr(file_name, cmd_buffer, 1, params.read_option);
+        if (params.mip_level <= 1) {
+            return image;
+        }
+        auto size = image.size();
+        auto chain = _lib.device().create_image<float>(image.storage(), size.x, size.y, params.mip_level);
+        cmd_buffer << chain.view(0).copy_from(image.view(0))
+                   << [image = std::move(image)] {};
+        _lib.generate_cubemap_mip(chain, cmd_buffer, params.roughness, params.prefilter_option);
+        return chain;
+    }
+    if (ext == ".exr") {
+        return _lib.read_exr(file_name, cmd_buffer, params.mip_level, params.read_option);
+    }
+    if (ext == ".hdr") {
+        return _lib.read_hdr(file_name, cmd_buffer, params.mip_level, params.read_option);
+    }
+    return _lib.read_ldr(file_name, cmd_buffer, params.mip_level, params.read_option);
+}
+Image<float> TextureCache::get(std::filesystem::path const &source, Params const &params, CommandBuffer &cmd_buffer) noexcept {
+    auto key = _key(source, params);
+    auto final_path = _dir / luisa::format("{:016x}{}", key, imglib_detail::cache_extension).c_str();
+    // map before anything else, another process may evict the entry at any time, the mapping
+    // stays readable; an entry that can not be mapped, or is truncated or corrupt, is a miss
+    MappedFile entry{final_path};
+    if (entry.valid()) {
+        luisa::string error;
+        auto image = _lib.load_image<float>(std::move(entry), cmd_buffer, error);
+        if (error.empty()) {
+            _hits++;
+            // the modification time orders the entries for eviction
+            std::error_code ec;
+            std::filesystem::last_write_time(final_path, std::filesystem::file_time_type::clock::now(), ec);
+            return image;
+        }
+        LUISA_WARNING("Texture cache entry {} is damaged, rebuilding it: {}", final_path.string(), error);
+    }
+    _misses++;
+    auto image = _process(source, params, cmd_buffer);
+    // unique per writer, across threads and processes
+    std::random_device random;
+    auto write = luisa::make_unique<imglib_detail::CacheWrite>();
+    write->final_path = final_path;
+    write->temp_path = _dir / luisa::format("{:016x}.{:08x}{:08x}{}", key, random(), random(), imglib_detail::temp_extension).c_str();
+    write->file = std::fopen(write->temp_path.string().c_str(), "wb");
+    if (write->file == nullptr) {
+        LUISA_WARNING("Can not write texture cache entry {}.", write->temp_path.string());
+        return image;
+    }
+    // the header at offset 0 is the last piece of a streaming save; block checksums let a hit
+    // reject an entry damaged on disk
+    _lib.save_image(
+        image, cmd_buffer, _pool, [this, write = std::move(write)](size_t offset, luisa::span<std::byte const> data) mutable {
+            if (!write->failed &&
+                (!imglib_detail::seek_file(write->file, offset) ||
+                 std::fwrite(data.data(), 1, data.size(), write->file) != data.size())) {
+                LUISA_WARNING("Writing texture cache entry {} failed.", write->temp_path.string());
+                write->failed = true;
+            }
+            if (offset != 0) {
+                return;
+            }
+            auto closed = std::fclose(write->file) == 0;
+            write->file = nullptr;
+            std::error_code ec;
+            if (!write->failed && closed) {
+                // atomic replace, a concurrent writer of the same key produces the same bytes
+                std::filesystem::rename(write->temp_path, write->final_path, ec);
+            }
+            if (write->failed || !closed || ec) {
+                std::filesystem::remove(write->temp_path, ec);
+                return;
+            }
+            evict();
+        },
+        true);
+    return image;
+}
+void TextureCache::evict() noexcept {
+    struct CacheFile {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        size_t size;
+    };
+    luisa::vector<CacheFile> files;
+    size_t total = 0;
+    std::error_code ec;
+    auto now = std::filesystem::file_time_type::clock::now();
+    for (auto iter = std::filesystem::directory_iterator{_dir, ec}; !ec && iter != std::filesystem::directory_iterator{}; iter.increment(ec)) {
+        auto &&entry = *iter;
+        std::error_code entry_ec;
+        if (!entry.is_regular_file(entry_ec)) {
+            continue;
+        }
+        auto ext = entry.path().extension();
+        auto time = entry.last_write_time(entry_ec);
+        if (entry_ec) {
+            continue;
+        }
+        if (ext == imglib_detail::temp_extension) {
+            if (now - time > imglib_detail::stale_temp_age) {
+                std::filesystem::remove(entry.path(), entry_ec);
+            }
+            continue;
+        }
+        if (ext != imglib_detail::cache_extension) {
+            continue;
+        }
+        auto size = static_cast<size_t>(entry.file_size(entry_ec));
+        if (entry_ec) {
+            continue;
+        }
+        files.push_back(CacheFile{entry.path(), time, size});
+        total += size;
+    }
+    if (total <= _max_bytes) {
+        return;
+    }
+    std::sort(files.begin(), files.end(), [](auto &&a, auto &&b) { return a.time < b.time; });
+    for (auto &&f : files) {
+        if (total <= _max_bytes) {
+            break;
+        }
+        // an entry mapped by a reader may fail to be removed on some platforms, it stays for the next round
+        if (std::filesystem::remove(f.path, ec)) {
+            total -= f.size;
+        }
+    }
+}
+}// namespace luisa::compute
@@ -0,0 +1,195 @@
+#include <tools/texture_residency.h>
+#include <core/logging.h>
+#include <algorithm>
+
+namespace luisa::compute {
+TextureResidency::TextureResidency(ImageLib &lib, Device &device, uint32_t slot_count, Option option) noexcept
+    : _lib(lib), _device(device), _array(device.create_bindless_array(slot_count)), _option(option), _slot_count(slot_count) {
+    _entries.reserve(slot_count);
+}
+TextureResidency::~TextureResidency() noexcept = default;
+size_t TextureResidency::_byte_size(Entry const &entry, uint32_t begin) const noexcept {
+    size_t size = 0;
+    for (auto level : vstd::range(begin, entry.info.mip_level)) {
+        size += pixel_storage_size(
+            entry.info.storage,
+            std::max(entry.info.size.x >> level, 1u),
+            std::max(entry.info.size.y >> level, 1u),
+            1u);
+    }
+    return size;
+}
+uint32_t TextureResidency::_tail_begin(Entry const &entry) const noexcept {
+    uint32_t level = 0;
+    while (level + 1 < entry.info.mip_level &&
+           std::max(entry.info.size.x >> level, entry.info.size.y >> level) > _option.tail_size) {
+        level++;
+    }
+    return level;
+}
+uint32_t TextureResidency::add(std::filesystem::path const &path) noexcept {
+    if (_entries.size() >= _slot_count) {
+        LUISA_ERROR("No free bindless slot for texture {}.", path.string());
+    }
+    auto info = _lib.read_image_info(path);
+    auto slot = static_cast<uint32_t>(_entries.size());
+    _entries.push_back(Entry{
+        .path = path,
+        .info = info,
+        .image = {},
+        .resident_begin = info.mip_level,
+        .wanted_begin = info.mip_level});
+    return slot;
+}
+void TextureResidency::request(uint32_t slot, uint32_t finest_mip) noexcept {
+    auto &&entry = _entries[slot];
+    entry.wanted_begin = std::min({entry.wanted_begin, finest_mip, entry.info.mip_level - 1});
+    entry.last_used = _frame + 1;
+}
+bool TextureResidency::is_resident(uint32_t slot) const noexcept {
+    auto &&entry = _entries[slot];
+    return entry.resident_begin < entry.info.mip_level;
+}
+uint32_t TextureResidency::resident_mip(uint32_t slot) const noexcept {
+    return _entries[slot].resident_begin;
+}
+void TextureResidency::_load(Entry &entry, uint32_t slot, uint32_t begin, CommandBuffer &cmd_buffer) noexcept {
+    auto image = [&] {
+        if (entry.resident_begin == entry.info.mip_level) {
+            return _lib.load_image<float>(entry.path, cmd_buffer, ImageLib::MipRange{begin, entry.info.mip_level});
+        }
+        // only the new fine mips are read from the file, the resident ones are copied on the device
+        auto fine = _lib.load_image<float>(entry.path, cmd_buffer, ImageLib::MipRange{begin, entry.resident_begin});
+        auto refined = _device.create_image<float>(
+            entry.info.storage,
+            std::max(entry.info.size.x >> begin, 1u),
+            std::max(entry.info.size.y >> begin, 1u),
+            entry.info.mip_level - begin);
+        for (auto i : vstd::range(fine.mip_levels())) {
+            cmd_buffer << refined.view(i).copy_from(fine.view(i));
+        }
+        for (auto i : vstd::range(entry.image.mip_levels())) {
+            cmd_buffer << refined.view(i + entry.resident_begin - begin).copy_from(entry.image.view(i));
+        }
+        cmd_buffer << [fine = std::move(fine)] {};
+        return refined;
+    }();
+    // the old image may still be read by work recorded before this update
+    cmd_buffer << [old = std::move(entry.image)] {};
+    entry.image = std::move(image);
+    _array.emplace(slot, entry.image, _option.sampler);
+    auto bytes = _byte_size(entry, begin);
+    _resident_bytes = _resident_bytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+    entry.resident_begin = begin;
+    _dirty = true;
+}
+void TextureResidency::_demote(Entry &entry, uint32_t slot, uint32_t begin, CommandBuffer &cmd_buffer) noexcept {
+    // the coarse mips are already on the device, no need to read the file again
+    auto image = _device.create_image<float>(
+        entry.info.storage,
+        std::max(entry.info.size.x >> begin, 1u),
+        std::max(entry.info.size.y >> begin, 1u),
+        entry.info.mip_level - begin);
+    for (auto i : vstd::range(image.mip_levels())) {
+        cmd_buffer << image.view(i).copy_from(entry.image.view(i + begin - entry.resident_begin));
+    }
+    cmd_buffer << [old = std::move(entry.image)] {};
+    entry.image = std::move(image);
+    _array.emplace(slot, entry.image, _option.sampler);
+    auto bytes = _byte_size(entry, begin);
+    _resident_bytes = _resident_bytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+    entry.resident_begin = begin;
+    _dirty = true;
+}
+void TextureResidency::_evict(Entry &entry, uint32_t slot, CommandBuffer &cmd_buffer) noexcept {
+    _array.remove_tex2d(slot);
+    cmd_buffer << [old = std::move(entry.image)] {};
+    _resident_bytes -= entry.bytes;
+    entry.bytes = 0;
+    entry.resident_begin = entry.info.mip_level;
+    _dirty = true;
+}
+bool TextureResidency::_make_room(size_t bytes, CommandBuffer &cmd_buffer) noexcept {
+    while (_resident_bytes + bytes > _option.budget_bytes) {
+        // least recently used first, drop fine mips of every texture before whole textures,
+        // textures requested for the coming frame are never touched
+        Entry *victim = nullptr;
+        bool victim_has_fine = false;
+        for (auto &&entry : _entries) {
+            if (entry.resident_begin >= entry.info.mip_level || entry.last_used > _frame) {
+                continue;
+            }
+            auto has_fine = entry.resident_begin < _tail_begin(entry);
+            if (victim == nullptr || has_fine > victim_has_fine ||
+                (has_fine == victim_has_fine && entry.last_used < victim->last_used)) {
+                victim = &entry;
+                victim_has_fine = has_fine;
+            }
+        }
+        if (victim == nullptr) {
+            return false;
+        }
+        auto slot = static_cast<uint32_t>(victim - _entries.data());
+        if (victim_has_fine) {
+            _demote(*victim, slot, _tail_begin(*victim), cmd_buffer);
+        } else {
+            _evict(*victim, slot, cmd_buffer);
+        }
+    }
+    return true;
+}
+void TextureResidency::update(CommandBuffer &cmd_buffer) noexcept {
+    // textures without any mip first, then refinements in slot order
+    luisa::vector<uint32_t> pending;
+    for (auto i : vstd::range(_entries.size())) {
+        auto &&entry = _entries[i];
+        if (entry.last_used > _frame && entry.wanted_begin < entry.resident_begin) {
+            pending.emplace_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::stable_sort(pending.begin(), pending.end(), [&](auto a, auto b) {
+        return _entries[a].resident_begin == _entries[a].info.mip_level &&
+               _entries[b].resident_begin < _entries[b].info.mip_level;
+    });
+    size_t upload_budget = _option.upload_bytes_per_update;
+    for (auto slot : pending) {
+        auto &&entry = _entries[slot];
+        auto tail = _tail_begin(entry);
+        // a texture first gets its tail, it is refined on later updates
+        auto first_load = entry.resident_begin == entry.info.mip_level;
+        auto target = first_load ? std::max(entry.wanted_begin, tail) : entry.wanted_begin;
+        // step towards coarser targets until the load fits this update and the budget;
+        // the first load ignores the per-update limit, a tail larger than it would never be resident
+        auto loaded = false;
+        for (; target < entry.resident_begin; ++target) {
+            auto bytes = _byte_size(entry, target);
+            // a refinement only reads the new mips
+            auto upload_bytes = bytes - entry.bytes;
+            if (!first_load && upload_bytes > upload_budget) {
+                continue;
+            }
+            if (_make_room(bytes - entry.bytes, cmd_buffer)) {
+                _load(entry, slot, target, cmd_buffer);
+                upload_budget -= std::min(upload_bytes, upload_budget);
+                loaded = true;
+                break;
+            }
+        }
+        if (first_load && !loaded && !entry.reported) {
+            entry.reported = true;
+            LUISA_WARNING("Texture {} does not fit the residency budget of {} bytes ({} bytes for its tail).",
+                          entry.path.string(), _option.budget_bytes, _byte_size(entry, std::max(entry.wanted_begin, tail)));
+        }
+    }
+    for (auto &&entry : _entries) {
+        entry.wanted_begin = entry.info.mip_level;
+    }
+    _frame++;
+    if (_dirty) {
+        cmd_buffer << _array.update();
+        _dirty = false;
+    }
+}
+}// namespace luisa::compute
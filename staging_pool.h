@@ -0,0 +1,42 @@
+#pragma once
+#include <tools/config.h>
+#include <vstl/common.h>
+#include <mutex>
+#include <condition_variable>
+
+namespace luisa::compute {
+// Host staging memory shared by streaming saves. Buffers handed out are accounted against
+// budget until released, released buffers are kept for reuse as long as they fit in the budget.
+class LC_TOOL_API StagingPool {
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    luisa::vector<luisa::vector<std::byte>> _free;
+    size_t _budget;
+    size_t _chunk_size;
+    size_t _in_use{0};
+    size_t _cached{0};
+    size_t _peak{0};
+    bool _fits(size_t size) const noexcept;
+    luisa::vector<std::byte> _take(size_t size) noexcept;
+
+public:
+    // chunk_size is rounded down to a multiple of 1 MiB and clamped to the budget
+    explicit StagingPool(size_t budget = 256ull << 20u, size_t chunk_size = 16ull << 20u) noexcept;
+    StagingPool(StagingPool const &) = delete;
+    StagingPool(StagingPool &&) = delete;
+    ~StagingPool() noexcept;
+    // largest piece a streaming save reads back at once
+    [[nodiscard]] size_t chunk_size() const noexcept { return _chunk_size; }
+    [[nodiscard]] size_t budget() const noexcept { return _budget; }
+    // high-water mark of the bytes handed out
+    [[nodiscard]] size_t peak_bytes() noexcept;
+    // returns an empty vector if the buffer would exceed the budget
+    [[nodiscard]] luisa::vector<std::byte> try_acquire(size_t size) noexcept;
+    // blocks until enough buffers are released, a single request larger than the budget
+    // is only granted once everything else has been released
+    [[nodiscard]] luisa::vector<std::byte> acquire(size_t size) noexcept;
+    void release(luisa::vector<std::byte> buffer) noexcept;
+    // drop every cached buffer
+    void trim() noexcept;
+};
+}// namespace luisa::compute
@@ -0,0 +1,228 @@
+#include "test_util.h"
+#include <core/logging.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace luisa::compute::test {
+namespace {
+// little-endian bit field of a block
+uint32_t block_bits(std::byte const *block, uint32_t offset, uint32_t count) noexcept {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto bit = offset + i;
+        value |= ((static_cast<uint32_t>(block[bit / 8]) >> (bit % 8)) & 1u) << i;
+    }
+    return value;
+}
+float half_to_float(uint32_t h) noexcept {
+    auto exponent = (h >> 10u) & 0x1fu;
+    auto mantissa = static_cast<float>(h & 0x3ffu);
+    auto value = exponent == 0 ? std::ldexp(mantissa, -24) : std::ldexp(1.0f + mantissa / 1024.0f, static_cast<int>(exponent) - 15);
+    return (h & 0x8000u) != 0 ? -value : value;
+}
+// the decoders follow the D3D block formats; BC6H and BC7 cover only the modes the encoders emit
+void decode_bc1(std::byte const *block, float4 (&texels)[16], bool four_color) noexcept {
+    auto c0 = block_bits(block, 0, 16);
+    auto c1 = block_bits(block, 16, 16);
+    auto unpack = [](uint32_t c) noexcept {
+        return make_float4(static_cast<float>(c >> 11u) / 31.0f, static_cast<float>((c >> 5u) & 63u) / 63.0f, static_cast<float>(c & 31u) / 31.0f, 1.0f);
+    };
+    float4 palette[4] = {unpack(c0), unpack(c1)};
+    if (four_color || c0 > c1) {
+        palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+        palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+    } else {
+        palette[2] = (palette[0] + palette[1]) * 0.5f;
+        palette[3] = make_float4(0.0f);
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        texels[i] = palette[block_bits(block, 32 + i * 2, 2)];
+    }
+}
+void decode_bc4(std::byte const *block, float (&values)[16]) noexcept {
+    auto a0 = block_bits(block, 0, 8);
+    auto a1 = block_bits(block, 8, 8);
+    float palette[8] = {a0 / 255.0f, a1 / 255.0f};
+    if (a0 > a1) {
+        for (uint32_t k = 2; k < 8; ++k) {
+            palette[k] = ((8 - k) * palette[0] + (k - 1) * palette[1]) / 7.0f;
+        }
+    } else {
+        for (uint32_t k = 2; k < 6; ++k) {
+            palette[k] = ((6 - k) * palette[0] + (k - 1) * palette[1]) / 5.0f;
+        }
+        palette[6] = 0.0f;
+        palette[7] = 1.0f;
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        values[i] = palette[block_bits(block, 16 + i * 3, 3)];
+    }
+}
+constexpr uint32_t index_weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+// 16 four-bit indices after the one-bit-shorter anchor index
+uint32_t index4(std::byte const *block, uint32_t offset, uint32_t i) noexcept {
+    return i == 0 ? block_bits(block, offset, 3) : block_bits(block, offset + 3 + (i - 1) * 4, 4);
+}
+bool decode_bc7_mode6(std::byte const *block, float4 (&texels)[16]) noexcept {
+    if (block_bits(block, 0, 7) != 1u << 6u) {
+        return false;
+    }
+    uint32_t e[2][4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        e[0][c] = (block_bits(block, 7 + c * 14, 7) << 1u) | block_bits(block, 63, 1);
+        e[1][c] = (block_bits(block, 14 + c * 14, 7) << 1u) | block_bits(block, 64, 1);
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto w = index_weights4[index4(block, 65, i)];
+        for (uint32_t c = 0; c < 4; ++c) {
+            texels[i][c] = static_cast<float>(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6u) / 255.0f;
+        }
+    }
+    return true;
+}
+bool decode_bc6_mode11(std::byte const *block, float4 (&texels)[16]) noexcept {
+    if (block_bits(block, 0, 5) != 3u) {
+        return false;
+    }
+    auto unquantize = [](uint32_t x) noexcept -> uint32_t {
+        if (x == 0) return 0;
+        if (x == 1023) return 0xffffu;
+        return ((x << 16u) + 0x8000u) >> 10u;
+    };
+    uint32_t e[2][3];
+    for (uint32_t c = 0; c < 3; ++c) {
+        e[0][c] = unquantize(block_bits(block, 5 + c * 10, 10));
+        e[1][c] = unquantize(block_bits(block, 35 + c * 10, 10));
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        auto w = index_weights4[index4(block, 65, i)];
+        for (uint32_t c = 0; c < 3; ++c) {
+            auto v = ((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6u;
+            texels[i][c] = half_to_float((v * 31u) >> 6u);
+        }
+        texels[i].w = 1.0f;
+    }
+    return true;
+}
+// the blocks of every mip survive save_image and load_image bit for bit
+void check_round_trip(TestEnv &env, Image<float> const &encoded, PixelStorage storage, char const *name) noexcept {
+    luisa::vector<std::byte> saved;
+    env.lib.save_image(encoded, env.cmd, [&](luisa::span<std::byte const> data) { saved.assign(data.begin(), data.end()); }, true);
+    env.sync();
+    auto path = env.work_dir / luisa::format("test_{}.lcim", name).c_str();
+    {
+        auto file = std::fopen(path.string().c_str(), "wb");
+        std::fwrite(saved.data(), 1, saved.size(), file);
+        std::fclose(file);
+    }
+    auto info = env.lib.read_image_info(path);
+    auto loaded = env.lib.load_image<float>(path, env.cmd);
+    auto same = info.storage == storage && loaded.storage() == storage && loaded.mip_levels() == encoded.mip_levels();
+    for (auto i : vstd::range(same ? encoded.mip_levels() : 0u)) {
+        luisa::vector<std::byte> expected(encoded.view(i).byte_size());
+        luisa::vector<std::byte> actual(loaded.view(i).byte_size());
+        env.cmd << encoded.view(i).copy_to(expected.data()) << loaded.view(i).copy_to(actual.data());
+        env.sync();
+        same &= expected.size() == actual.size() && memcmp(expected.data(), actual.data(), expected.size()) == 0;
+    }
+    check(same, luisa::format("{} save_image / load_image round trip", name));
+}
+}// namespace
+void test_block_compress(TestEnv &env) noexcept {
+    constexpr uint32_t size = 64;
+    // smooth gradients, every 4x4 block stays close to a line in color space
+    luisa::vector<float4> ldr(size * size);
+    luisa::vector<float4> hdr(size * size);
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            auto s = static_cast<float>(x + 2 * y) / static_cast<float>(3 * (size - 1));
+            ldr[y * size + x] = make_float4(s, s * s, 1.0f - s, 0.25f + 0.5f * s);
+            hdr[y * size + x] = make_float4(16.0f * s + 0.05f, 4.0f * s * s + 0.1f, 2.0f * (1.0f - s) + 0.01f, 1.0f);
+        }
+    }
+    // a few mips, so the save_image round trip covers the block sizes of the smaller levels
+    constexpr uint32_t mips = 3;
+    auto ldr_img = env.device.create_image<float>(PixelStorage::FLOAT4, size, size, mips);
+    auto hdr_img = env.device.create_image<float>(PixelStorage::FLOAT4, size, size, mips);
+    env.cmd << ldr_img.view(0).copy_from(ldr.data()) << hdr_img.view(0).copy_from(hdr.data());
+    env.lib.generate_mip(ldr_img, env.cmd);
+    env.lib.generate_mip(hdr_img, env.cmd);
+    struct Case {
+        PixelStorage storage;
+        char const *name;
+        uint32_t channels;
+        // RMSE over the channels, relative to the source texel for BC6H
+        float max_error;
+    };
+    Case cases[] = {
+        {PixelStorage::BC1, "BC1", 3, 0.03f},
+        {PixelStorage::BC3, "BC3", 4, 0.03f},
+        {PixelStorage::BC4, "BC4", 1, 0.01f},
+        {PixelStorage::BC5, "BC5", 2, 0.01f},
+        {PixelStorage::BC6, "BC6H", 3, 0.03f},
+        {PixelStorage::BC7, "BC7", 4, 0.02f}};
+    for (auto &&c : cases) {
+        auto is_hdr = c.storage == PixelStorage::BC6;
+        auto &&source = is_hdr ? hdr : ldr;
+        auto encoded = env.lib.compress(is_hdr ? hdr_img : ldr_img, c.storage, env.cmd);
+        luisa::vector<std::byte> blocks(encoded.view(0).byte_size());
+        env.cmd << encoded.view(0).copy_to(blocks.data());
+        env.sync();
+        auto block_size = blocks.size() / ((size / 4) * (size / 4));
+        auto layout_ok = true;
+        double error = 0.0;
+        for (uint32_t by = 0; by < size / 4; ++by) {
+            for (uint32_t bx = 0; bx < size / 4; ++bx) {
+                auto block = blocks.data() + (by * (size / 4) + bx) * block_size;
+                float4 texels[16];
+                switch (c.storage) {
+                    case PixelStorage::BC1:
+                        decode_bc1(block, texels, false);
+                        break;
+                    case PixelStorage::BC3: {
+                        float alpha[16];
+                        decode_bc4(block, alpha);
+                        decode_bc1(block + 8, texels, true);
+                        for (uint32_t i = 0; i < 16; ++i) {
+                            texels[i].w = alpha[i];
+                        }
+                        break;
+                    }
+                    case PixelStorage::BC4:
+                    case PixelStorage::BC5: {
+                        float red[16];
+                        float green[16] = {};
+                        decode_bc4(block, red);
+                        if (c.storage == PixelStorage::BC5) {
+                            decode_bc4(block + 8, green);
+                        }
+                        for (uint32_t i = 0; i < 16; ++i) {
+                            texels[i] = make_float4(red[i], green[i], 0.0f, 1.0f);
+                        }
+                        break;
+                    }
+                    case PixelStorage::BC6:
+                        layout_ok &= decode_bc6_mode11(block, texels);
+                        break;
+                    default:
+                        layout_ok &= decode_bc7_mode6(block, texels);
+                        break;
+                }
+                for (uint32_t i = 0; i < 16; ++i) {
+                    auto ref = source[(by * 4 + i / 4) * size + bx * 4 + i % 4];
+                    for (uint32_t ch = 0; ch < c.channels; ++ch) {
+                        auto d = texels[i][ch] - ref[ch];
+                        error += is_hdr ? d * d / (ref[ch] * ref[ch]) : d * d;
+                    }
+                }
+            }
+        }
+        auto rmse = std::sqrt(error / (static_cast<double>(size) * size * c.channels));
+        LUISA_INFO("{} RMSE {}", c.name, rmse);
+        check(layout_ok, luisa::format("{} block mode", c.name));
+        check(rmse < c.max_error, luisa::format("{} RMSE {} below {}", c.name, rmse, c.max_error));
+        check_round_trip(env, encoded, c.storage, c.name);
+    }
+}
+}// namespace luisa::compute::test
@@ -0,0 +1,93 @@
+#include "test_util.h"
+#include <tools/texture_residency.h>
+#include <core/logging.h>
+#include <cstdio>
+
+namespace luisa::compute::test {
+namespace {
+constexpr uint32_t texture_size = 64;
+// 64x64 FLOAT4, the full chain and its tail of mips no larger than 8
+constexpr size_t full_bytes = 16u * (4096u + 1024u + 256u + 64u + 16u + 4u + 1u);
+constexpr size_t tail_bytes = 16u * (64u + 16u + 4u + 1u);
+constexpr uint32_t tail_mip = 3;
+std::filesystem::path write_texture(TestEnv &env, uint32_t mips) noexcept {
+    auto image = env.device.create_image<float>(PixelStorage::FLOAT4, texture_size, texture_size, mips);
+    luisa::vector<float4> texels(texture_size * texture_size);
+    for (auto i : vstd::range(texels.size())) {
+        texels[i] = make_float4(static_cast<float>(i % texture_size) / texture_size, static_cast<float>(i / texture_size) / texture_size, 0.5f, 1.0f);
+    }
+    env.cmd << image.view(0).copy_from(texels.data());
+    env.lib.generate_mip(image, env.cmd);
+    auto path = env.work_dir / luisa::format("test_residency_{}.lcim", mips).c_str();
+    env.lib.save_image(image, env.cmd, [path](luisa::span<std::byte const> data) {
+        auto file = std::fopen(path.string().c_str(), "wb");
+        std::fwrite(data.data(), 1, data.size(), file);
+        std::fclose(file);
+    });
+    env.sync();
+    return path;
+}
+struct Frame {
+    TestEnv &env;
+    TextureResidency &residency;
+    // request the slots for mip 0, then update
+    void operator()(std::initializer_list<uint32_t> slots) noexcept {
+        for (auto slot : slots) {
+            residency.request(slot, 0);
+        }
+        residency.update(env.cmd);
+        env.sync();
+    }
+};
+}// namespace
+void test_residency(TestEnv &env) noexcept {
+    auto chain_path = write_texture(env, 7);
+    auto single_path = write_texture(env, 1);
+    // least recently used textures lose their fine mips before anyone loses a tail
+    {
+        TextureResidency residency{env.lib, env.device, 4, {.budget_bytes = 2 * full_bytes + 2 * tail_bytes, .tail_size = 8}};
+        Frame frame{env, residency};
+        auto a = residency.add(chain_path);
+        auto b = residency.add(chain_path);
+        auto c = residency.add(chain_path);
+        frame({a, b});
+        check(residency.resident_mip(a) == tail_mip && residency.resident_mip(b) == tail_mip, "residency first load brings the tail");
+        frame({a, b});
+        check(residency.resident_mip(a) == 0 && residency.resident_mip(b) == 0, "residency refines to mip 0");
+        frame({b});
+        frame({c});
+        frame({c});
+        check(residency.resident_mip(c) == 0, "residency refines the new texture");
+        check(residency.resident_mip(a) == tail_mip, "residency demotes the least recently used texture to its tail");
+        check(residency.resident_mip(b) == 0, "residency keeps the more recently used texture");
+        check(residency.resident_bytes() == 2 * full_bytes + tail_bytes && residency.resident_bytes() <= 2 * full_bytes + 2 * tail_bytes,
+              luisa::format("residency stays within its budget ({} bytes)", residency.resident_bytes()));
+    }
+    // textures left with only their tail are evicted whole
+    {
+        TextureResidency residency{env.lib, env.device, 2, {.budget_bytes = full_bytes + 1000u, .tail_size = 8}};
+        Frame frame{env, residency};
+        auto a = residency.add(chain_path);
+        auto b = residency.add(chain_path);
+        frame({a});
+        frame({a});
+        frame({b});
+        check(residency.resident_mip(a) == tail_mip && residency.resident_mip(b) == tail_mip, "residency demotes to make room for a tail");
+        frame({b});
+        check(!residency.is_resident(a) && residency.resident_mip(b) == 0, "residency evicts a tail-only texture");
+        check(residency.resident_bytes() == full_bytes, luisa::format("residency accounts the eviction ({} bytes)", residency.resident_bytes()));
+    }
+    // the first load ignores the per-update limit, refinements wait for it
+    {
+        TextureResidency residency{env.lib, env.device, 2, {.upload_bytes_per_update = 1024u, .tail_size = 8}};
+        Frame frame{env, residency};
+        auto single = residency.add(single_path);
+        auto chain = residency.add(chain_path);
+        frame({single, chain});
+        check(residency.resident_mip(single) == 0, "residency loads a single-mip texture larger than the per-update limit");
+        check(residency.resident_mip(chain) == tail_mip, "residency loads a tail larger than the per-update limit");
+        frame({single, chain});
+        check(residency.resident_mip(chain) == tail_mip, "residency holds back refinements over the per-update limit");
+    }
+}
+}// namespace luisa::compute::test
@@ -0,0 +1,48 @@
+// Checks of the ImageLib operations against host references.
+// usage: lc-tools-test [backend = cpu] [work_dir]
+#include "test_util.h"
+#include <runtime/context.h>
+#include <core/logging.h>
+#include <atomic>
+
+using namespace luisa;
+using namespace luisa::compute;
+
+namespace luisa::compute::test {
+static std::atomic_uint32_t failure_count{0};
+bool check(bool condition, luisa::string_view what) noexcept {
+    if (!condition) {
+        failure_count++;
+        LUISA_WARNING("Check failed: {}", what);
+    }
+    return condition;
+}
+}// namespace luisa::compute::test
+
+int main(int argc, char *argv[]) {
+    luisa::string backend = argc > 1 ? argv[1] : "cpu";
+    auto work_dir = argc > 2 ? std::filesystem::path{argv[2]} : std::filesystem::temp_directory_path() / "lc_tools_test";
+    std::filesystem::create_directories(work_dir / "shaders");
+    Context context{argv[0]};
+    auto device = context.create_device(backend);
+    auto stream = device.create_stream();
+    auto cmd = stream.command_buffer();
+    ImageLib lib{device, luisa::string{(work_dir / "shaders").string().c_str()}};
+    test::TestEnv env{device, stream, cmd, lib, work_dir};
+    struct TestCase {
+        char const *name;
+        void (*func)(test::TestEnv &) noexcept;
+    };
+    TestCase tests[] = {
+        {"block_compress", test::test_block_compress},
+        {"volume", test::test_volume},
+        {"residency", test::test_residency}};
+    for (auto &&t : tests) {
+        auto before = test::failure_count.load();
+        t.func(env);
+        LUISA_INFO("{}: {}", t.name, test::failure_count.load() == before ? "passed" : "FAILED");
+    }
+    auto failures = test::failure_count.load();
+    LUISA_INFO("{} failed checks.", failures);
+    return failures == 0 ? 0 : 1;
+}
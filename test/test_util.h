@@ -0,0 +1,23 @@
+#pragma once
+#include <tools/image_lib.h>
+#include <runtime/device.h>
+#include <runtime/stream.h>
+
+namespace luisa::compute::test {
+struct TestEnv {
+    Device &device;
+    Stream &stream;
+    CommandBuffer &cmd;
+    ImageLib &lib;
+    std::filesystem::path work_dir;
+    void sync() noexcept {
+        cmd << commit();
+        stream.synchronize();
+    }
+};
+// log and count a failed check, the test goes on
+bool check(bool condition, luisa::string_view what) noexcept;
+void test_block_compress(TestEnv &env) noexcept;
+void test_volume(TestEnv &env) noexcept;
+void test_residency(TestEnv &env) noexcept;
+}// namespace luisa::compute::test
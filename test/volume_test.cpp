@@ -0,0 +1,161 @@
+#include "test_util.h"
+#include <core/binary_io_visitor.h>
+#include <core/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace luisa::compute::test {
+namespace {
+class MemoryStream final : public IBinaryStream {
+    luisa::span<std::byte const> _data;
+    size_t _pos{0};
+
+public:
+    explicit MemoryStream(luisa::span<std::byte const> data) noexcept : _data(data) {}
+    [[nodiscard]] size_t length() const noexcept override { return _data.size(); }
+    [[nodiscard]] size_t pos() const noexcept override { return _pos; }
+    void read(luisa::span<std::byte> dst) noexcept override {
+        auto size = std::min(dst.size(), _data.size() - _pos);
+        memcpy(dst.data(), _data.data() + _pos, size);
+        _pos += size;
+    }
+};
+using VolumeTexels = luisa::vector<luisa::vector<float4>>;
+VolumeTexels read_back(TestEnv &env, Volume<float> const &volume) noexcept {
+    VolumeTexels mips(volume.mip_levels());
+    for (auto level : vstd::range(volume.mip_levels())) {
+        auto size = volume.view(level).size();
+        mips[level].resize(static_cast<size_t>(size.x) * size.y * size.z);
+        env.cmd << volume.view(level).copy_to(mips[level].data());
+    }
+    env.sync();
+    return mips;
+}
+// mips [first, first + loaded.size()) of expected, bit for bit
+bool same_mips(VolumeTexels const &expected, VolumeTexels const &loaded, size_t first = 0) noexcept {
+    if (loaded.size() + first != expected.size()) {
+        return false;
+    }
+    for (auto i : vstd::range(loaded.size())) {
+        auto &&e = expected[first + i];
+        if (e.size() != loaded[i].size() || memcmp(e.data(), loaded[i].data(), e.size() * sizeof(float4)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+// weights of the source texels 2x, 2x + 1, 2x + 2 along one axis, odd sizes use a three-tap box
+void axis_weights(uint32_t x, uint32_t src_size, float (&w)[3]) noexcept {
+    auto dst_size = std::max(src_size / 2u, 1u);
+    if (src_size == 1) {
+        w[0] = 1.0f, w[1] = 0.0f, w[2] = 0.0f;
+    } else if (src_size % 2 == 0) {
+        w[0] = 0.5f, w[1] = 0.5f, w[2] = 0.0f;
+    } else {
+        auto inv = 1.0f / static_cast<float>(src_size);
+        w[0] = static_cast<float>(dst_size - x) * inv;
+        w[1] = static_cast<float>(dst_size) * inv;
+        w[2] = static_cast<float>(x + 1) * inv;
+    }
+}
+luisa::vector<float4> box_filter(luisa::vector<float4> const &src, uint3 src_size) noexcept {
+    auto dst_size = max(src_size / 2u, make_uint3(1u));
+    luisa::vector<float4> dst(static_cast<size_t>(dst_size.x) * dst_size.y * dst_size.z);
+    for (uint32_t z = 0; z < dst_size.z; ++z) {
+        for (uint32_t y = 0; y < dst_size.y; ++y) {
+            for (uint32_t x = 0; x < dst_size.x; ++x) {
+                float wx[3], wy[3], wz[3];
+                axis_weights(x, src_size.x, wx);
+                axis_weights(y, src_size.y, wy);
+                axis_weights(z, src_size.z, wz);
+                auto sum = make_float4(0.0f);
+                for (uint32_t k = 0; k < 3; ++k) {
+                    for (uint32_t j = 0; j < 3; ++j) {
+                        for (uint32_t i = 0; i < 3; ++i) {
+                            auto sx = std::min(x * 2 + i, src_size.x - 1);
+                            auto sy = std::min(y * 2 + j, src_size.y - 1);
+                            auto sz = std::min(z * 2 + k, src_size.z - 1);
+                            sum += src[(static_cast<size_t>(sz) * src_size.y + sy) * src_size.x + sx] * (wx[i] * wy[j] * wz[k]);
+                        }
+                    }
+                }
+                dst[(static_cast<size_t>(z) * dst_size.y + y) * dst_size.x + x] = sum;
+            }
+        }
+    }
+    return dst;
+}
+void check_volume(TestEnv &env, uint3 size) noexcept {
+    auto name = luisa::format("volume {}x{}x{}", size.x, size.y, size.z);
+    uint32_t mips = 1;
+    while ((std::max({size.x, size.y, size.z}) >> mips) != 0) {
+        mips++;
+    }
+    auto volume = env.device.create_volume<float>(PixelStorage::FLOAT4, size.x, size.y, size.z, mips);
+    luisa::vector<float4> texels(static_cast<size_t>(size.x) * size.y * size.z);
+    for (auto i : vstd::range(texels.size())) {
+        auto f = static_cast<float>(i);
+        texels[i] = make_float4(std::sin(f * 0.37f), std::cos(f * 0.11f), std::fmod(f, 17.0f) / 17.0f, 1.0f);
+    }
+    env.cmd << volume.view(0).copy_from(texels.data());
+    env.lib.generate_volume_mip(volume, env.cmd);
+    auto device_mips = read_back(env, volume);
+    // generate_volume_mip against the host box filter, level by level from the device's previous level
+    auto level_size = size;
+    for (auto level : vstd::range(1u, mips)) {
+        auto expected = box_filter(device_mips[level - 1], level_size);
+        level_size = max(level_size / 2u, make_uint3(1u));
+        auto &&actual = device_mips[level];
+        auto max_error = 0.0f;
+        for (auto i : vstd::range(std::min(expected.size(), actual.size()))) {
+            for (auto c : vstd::range(4)) {
+                max_error = std::max(max_error, std::abs(expected[i][c] - actual[i][c]));
+            }
+        }
+        check(expected.size() == actual.size() && max_error < 1e-4f,
+              luisa::format("{} mip {} matches the host box filter (max error {})", name, level, max_error));
+    }
+    // save_volume into memory, then load from a file and from a stream
+    luisa::vector<std::byte> saved;
+    env.lib.save_volume(volume, env.cmd, [&](luisa::span<std::byte const> data) { saved.assign(data.begin(), data.end()); }, true);
+    env.sync();
+    auto path = env.work_dir / luisa::format("test_volume_{}x{}x{}.lcim", size.x, size.y, size.z).c_str();
+    {
+        auto file = std::fopen(path.string().c_str(), "wb");
+        std::fwrite(saved.data(), 1, saved.size(), file);
+        std::fclose(file);
+    }
+    auto from_file = env.lib.load_volume<float>(path, env.cmd);
+    check(same_mips(device_mips, read_back(env, from_file)), luisa::format("{} file round trip", name));
+    MemoryStream stream{saved};
+    auto from_stream = env.lib.load_volume<float>(&stream, env.cmd);
+    check(same_mips(device_mips, read_back(env, from_stream)), luisa::format("{} stream round trip", name));
+    MemoryStream skip_stream{saved};
+    auto coarse = env.lib.load_volume<float>(&skip_stream, env.cmd, ImageLib::MipRange::skip(1));
+    check(same_mips(device_mips, read_back(env, coarse), 1), luisa::format("{} stream load without mip 0", name));
+    // the streaming save writes the same file through the staging pool
+    StagingPool pool{1u << 20u, 1u << 20u};
+    auto streamed_path = path;
+    streamed_path += ".streamed";
+    {
+        auto file = std::fopen(streamed_path.string().c_str(), "wb");
+        env.lib.save_volume(volume, env.cmd, pool, [file](size_t offset, luisa::span<std::byte const> data) {
+            std::fseek(file, static_cast<long>(offset), SEEK_SET);
+            std::fwrite(data.data(), 1, data.size(), file);
+        }, true);
+        env.sync();
+        std::fclose(file);
+    }
+    auto from_streamed = env.lib.load_volume<float>(streamed_path, env.cmd);
+    check(same_mips(device_mips, read_back(env, from_streamed)), luisa::format("{} streaming save round trip", name));
+}
+}// namespace
+void test_volume(TestEnv &env) noexcept {
+    // the even-size kernel, then odd sizes and a flat axis through the three-tap kernel
+    check_volume(env, make_uint3(16u, 16u, 8u));
+    check_volume(env, make_uint3(13u, 10u, 7u));
+    check_volume(env, make_uint3(9u, 6u, 1u));
+}
+}// namespace luisa::compute::test
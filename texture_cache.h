@@ -0,0 +1,46 @@
+#pragma once
+#include <tools/image_lib.h>
+#include <atomic>
+
+namespace luisa::compute {
+// Cache of processed textures in the save_image format, keyed by the hash of the source file
+// contents and of the processing parameters. Entries are written to a temporary file and renamed
+// into place, so several processes can share a cache directory; the least recently used entries
+// are removed once the directory grows beyond max_bytes.
+class LC_TOOL_API TextureCache {
+public:
+    // everything applied to the decoded source, part of the key
+    struct Params {
+        uint32_t mip_level{1};
+        // prefilter the mips of a lat-long .exr or .hdr environment map with generate_cubemap_mip
+        // instead of box-filtering them, other sources are rejected. roughness 0 keeps the mirror lobe
+        bool prefilter{false};
+        float roughness{0.0f};
+        ImageLib::PrefilterOption prefilter_option{};
+        ImageLib::ReadOption read_option{};
+    };
+
+private:
+    ImageLib &_lib;
+    std::filesystem::path _dir;
+    size_t _max_bytes;
+    StagingPool _pool;
+    std::atomic_uint64_t _hits{0};
+    std::atomic_uint64_t _misses{0};
+    uint64_t _key(std::filesystem::path const &source, Params const &params) const noexcept;
+    Image<float> _process(std::filesystem::path const &source, Params const &params, CommandBuffer &cmd_buffer) noexcept;
+
+public:
+    TextureCache(ImageLib &lib, std::filesystem::path dir, size_t max_bytes = 4ull << 30u) noexcept;
+    TextureCache(TextureCache const &) = delete;
+    TextureCache(TextureCache &&) = delete;
+    ~TextureCache() noexcept;
+    // Load the processed texture from the cache, or decode and process the source and store
+    // the result once the command buffer has executed. The cache must outlive that execution.
+    Image<float> get(std::filesystem::path const &source, Params const &params, CommandBuffer &cmd_buffer) noexcept;
+    // remove the least recently used entries, and stale temporary files, until the directory fits max_bytes
+    void evict() noexcept;
+    [[nodiscard]] uint64_t hits() const noexcept { return _hits.load(); }
+    [[nodiscard]] uint64_t misses() const noexcept { return _misses.load(); }
+};
+}// namespace luisa::compute
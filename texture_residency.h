@@ -0,0 +1,71 @@
+#pragma once
+#include <tools/image_lib.h>
+
+namespace luisa::compute {
+// Streams textures saved by ImageLib::save_image into the slots of a bindless array under a
+// device memory budget. A texture is loaded on its first request, coarsest mips first, and
+// refined towards the requested mip on later updates; when over budget the fine mips, then
+// whole textures, of the least recently requested slots are dropped.
+// at namespace scope to be usable as a defaulted constructor argument, see ImageMipRange
+struct TextureResidencyOption {
+    size_t budget_bytes{1ull << 30u};
+    // device bytes loaded per update, refinement beyond it waits for the next update;
+    // the first load of a texture is never held back by it
+    size_t upload_bytes_per_update{64ull << 20u};
+    // the first load of a texture only brings the mips no larger than this
+    uint32_t tail_size{64};
+    Sampler sampler{Sampler::linear_linear_repeat()};
+};
+class LC_TOOL_API TextureResidency {
+public:
+    using Option = TextureResidencyOption;
+
+private:
+    struct Entry {
+        std::filesystem::path path;
+        ImageLib::ImageInfo info;
+        Image<float> image;
+        // finest resident mip, info.mip_level when nothing is resident
+        uint32_t resident_begin;
+        // finest mip requested since the last update
+        uint32_t wanted_begin;
+        uint64_t last_used{0};
+        size_t bytes{0};
+        // a tail that can not fit the budget is reported once
+        bool reported{false};
+    };
+    ImageLib &_lib;
+    Device &_device;
+    BindlessArray _array;
+    Option _option;
+    uint32_t _slot_count;
+    luisa::vector<Entry> _entries;
+    uint64_t _frame{0};
+    size_t _resident_bytes{0};
+    bool _dirty{false};
+    size_t _byte_size(Entry const &entry, uint32_t begin) const noexcept;
+    uint32_t _tail_begin(Entry const &entry) const noexcept;
+    void _load(Entry &entry, uint32_t slot, uint32_t begin, CommandBuffer &cmd_buffer) noexcept;
+    void _demote(Entry &entry, uint32_t slot, uint32_t begin, CommandBuffer &cmd_buffer) noexcept;
+    void _evict(Entry &entry, uint32_t slot, CommandBuffer &cmd_buffer) noexcept;
+    bool _make_room(size_t bytes, CommandBuffer &cmd_buffer) noexcept;
+
+public:
+    TextureResidency(ImageLib &lib, Device &device, uint32_t slot_count, Option option = {}) noexcept;
+    TextureResidency(TextureResidency const &) = delete;
+    TextureResidency(TextureResidency &&) = delete;
+    ~TextureResidency() noexcept;
+    // register a file, only its header is read, returns the bindless slot
+    uint32_t add(std::filesystem::path const &path) noexcept;
+    // mark the slot as used this frame and ask for mips from finest_mip on
+    void request(uint32_t slot, uint32_t finest_mip = 0) noexcept;
+    // issue the loads and evictions decided since the last update and update the bindless array,
+    // the new mips become visible to work recorded after this call
+    void update(CommandBuffer &cmd_buffer) noexcept;
+    [[nodiscard]] BindlessArray const &array() const noexcept { return _array; }
+    [[nodiscard]] size_t resident_bytes() const noexcept { return _resident_bytes; }
+    [[nodiscard]] bool is_resident(uint32_t slot) const noexcept;
+    // finest mip of the file currently in the slot, the mip count of the file when not resident
+    [[nodiscard]] uint32_t resident_mip(uint32_t slot) const noexcept;
+};
+}// namespace luisa::compute
@@ -10,3 +10,25 @@ add_deps("lc-runtime", "lc-dsl", "lc-vstl", "tinyexr")
 add_defines("LC_TOOL_EXPORT_DLL")
 add_files("src/**.cpp", "../ext/stb/stb.c")
 add_includedirs("../ext/stb/")
+
+_config_project({
+    project_name = "lc-tools-bench",
+    project_kind = "binary"
+})
+add_deps("lc-tools", "lc-runtime", "lc-dsl", "lc-vstl", "tinyexr")
+add_files("bench/**.cpp", "../ext/stb/stb.c")
+add_includedirs("../ext/stb/")
+
+_config_project({
+    project_name = "lc-tools-baker",
+    project_kind = "binary"
+})
+add_deps("lc-tools", "lc-runtime", "lc-dsl", "lc-vstl")
+add_files("bake/**.cpp")
+
+_config_project({
+    project_name = "lc-tools-test",
+    project_kind = "binary"
+})
+add_deps("lc-tools", "lc-runtime", "lc-dsl", "lc-vstl")
+add_files("test/**.cpp")